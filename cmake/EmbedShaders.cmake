@@ -0,0 +1,27 @@
+#########################################
+#   Embed shader sources into a header  #
+#########################################
+# usage: cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P EmbedShaders.cmake
+#
+# Writes every shader of SHADER_DIR as raw string literal into a table that
+# shaderSource(...) in src/mygl/shader.cpp looks up by file name.
+
+file(GLOB SHADER_FILES ${SHADER_DIR}/*.vert ${SHADER_DIR}/*.frag ${SHADER_DIR}/*.comp ${SHADER_DIR}/*.glsl)
+list(SORT SHADER_FILES)
+
+set(CONTENT "// generated by cmake/EmbedShaders.cmake from ${SHADER_DIR}, do not edit\n#pragma once\n\n")
+string(APPEND CONTENT "static const struct\n{\n    const char* name;\n    const char* source;\n} sEmbeddedShaders[] = {\n")
+foreach(SHADER_FILE ${SHADER_FILES})
+    get_filename_component(SHADER_NAME ${SHADER_FILE} NAME)
+    file(READ ${SHADER_FILE} SHADER_SOURCE)
+    string(APPEND CONTENT "    {\"${SHADER_NAME}\", R\"glsl(${SHADER_SOURCE})glsl\"},\n")
+endforeach()
+string(APPEND CONTENT "};\n")
+
+# only touch the header if a shader changed, so unrelated builds don't recompile shader.cpp
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
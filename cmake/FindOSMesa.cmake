@@ -0,0 +1,14 @@
+#########################################
+#            Find OSMesa                #
+#########################################
+# Required by GLFW when it is built with GLFW_USE_OSMESA (BUILD_HEADLESS).
+# GLFW loads libOSMesa at runtime, so only its presence is checked here.
+#
+# Defines OSMESA_FOUND, OSMESA_LIBRARY and OSMESA_INCLUDE_DIR.
+
+find_path(OSMESA_INCLUDE_DIR GL/osmesa.h)
+find_library(OSMESA_LIBRARY NAMES OSMesa OSMesa32 osmesa)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(OSMesa REQUIRED_VARS OSMESA_LIBRARY)
+mark_as_advanced(OSMESA_INCLUDE_DIR OSMESA_LIBRARY)
@@ -1,16 +1,55 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <ctime>
 #include <iostream>
+#include <random>
+#include <stdexcept>
 
+#include "mygl/arena.h"
 #include "mygl/camera.h"
+#include "mygl/debuglog.h"
+#include "mygl/framepacer.h"
 #include "mygl/geometry.h"
+#include "mygl/glstate.h"
+#include "mygl/gpucull.h"
+#include "mygl/impostor.h"
 #include "mygl/mesh.h"
+#include "mygl/meshlod.h"
+#include "mygl/meshopt.h"
+#include "mygl/recorder.h"
+#include "mygl/renderscale.h"
+#include "mygl/rendergraph.h"
+#include "mygl/renderqueue.h"
+#include "mygl/screenshot.h"
+#include "mygl/resource.h"
 #include "mygl/shader.h"
+#include "mygl/staticbatch.h"
 
 #include "ground.h"
 
+/* ring buffer for per-frame data, a frame has to fit into it */
+#define SCENE_STREAM_SIZE (4 << 20)
+
+/* upper bound of the CRATES stress test, the culling buffers take 144 bytes per crate */
+#define SCENE_MAX_CRATES 1000000ul
+
+/* every car drawn as a mesh uploads a full palette block, at most half of the stream ring go to them */
+#define SCENE_MAX_PARKED_CARS (SCENE_STREAM_SIZE / 2 / (STATIC_BATCH_MAX_PARTS * sizeof(Matrix4D)))
+
+/* feature bits of the default shader permutations */
+enum eShaderFeature { Checkerboard = 1u << 0, MatrixPalette = 1u << 1, Dither = 1u << 2 };
+
+/* parts of the car batch, index into its palette */
+enum eCarPart { CarBase, CarWindow, CarBottomLeftWheel, CarBottomRightWheel, CarTopLeftWheel, CarTopRightWheel,
+                CarSpareWheel, CarPartCount };
+
 // Forward-declaration
 void updateCarRotation(const Matrix4D& rotationMatrix);
 static Vector3D getCarPosition();
+static void sceneCarPalette();
+static void sceneDrawCarRest(void *user);
+static void sceneBindCarDraw(GLuint program, const DrawPacket &packet);
 
 /* struct holding all necessary state variables for scene */
 struct {
@@ -22,19 +61,32 @@ struct {
     float lastMovementDirection;
 
 
+    /* shared vertex/index storage of all meshes in the scene */
+    MegaBuffer geometry;
+
+    /* ring buffer for all data uploaded per frame */
+    StreamBuffer stream;
+
     /* game objects */
     Ground ground;
 
-    /* cubes */
-    Mesh baseCarMesh;
-    Mesh windowCarMesh;
+    /* car body (cubes) and wheels (cylinders) merged into one draw */
+    StaticBatch car;
 
-    /* cylinders */
-    Mesh bottomLeftWheelMesh;
-    Mesh bottomRightWheelMesh;
-    Mesh topLeftWheelMesh;
-    Mesh topRightWheelMesh;
-    Mesh spareWheelMesh;
+    /* palette of the car where it starts, the pose captured by the impostor */
+    std::vector<Matrix4D> carRestPalette;
+
+    /* distant cars are drawn as camera facing quads textured with pre-rendered views */
+    ImpostorAtlas carImpostor;
+    float impostorPixels;
+    GLuint fadeProgram;
+    UniformHandle fadeUniform;
+    std::vector<Matrix4D> parkedCars;
+    unsigned int carsAsMesh;
+
+    /* scattered crates, frustum culled on the GPU and drawn with one indirect draw */
+    Mesh crateMesh;
+    GpuCull crates;
 
     /* transformation matrices */
 
@@ -80,9 +132,34 @@ struct {
     float frontWheelSpinAccumulator;
 
     /* shader */
-    ShaderProgram shaderColor;
+    ShaderPermutations shaderColor;
+    uint32_t groundFeatures;
+    ShaderWatcher shaderWatcher;
+
+    /* draws of the current frame, sorted by state and depth before they are issued */
+    RenderQueue queue;
+
+    /* passes of the frame and the transient targets they share */
+    RenderGraph graph;
+
+    /* scene resolution follows the GPU frame time, scaled up to the window at the end of the frame */
+    RenderScale renderScale;
+
+    /* swap interval, frame limiter and frames in flight of the main loop */
+    FramePacer pacer;
+
+    /* render on demand: without changes the main loop sleeps in glfwWaitEventsTimeout instead of redrawing */
+    bool idleMode;
+    bool redraw;
+    unsigned long framesDrawn;
+    unsigned long framesSkipped;
+    double reportWallTime;
+    std::clock_t reportCpuTime;
 } sScene;
 
+/* longest sleep without events, bounds the latency of shader hot reload while idle */
+const double idleWaitSeconds = 0.25;
+
 /* calculate how much the car approximately turns per meter travelled for a given turning angle */
 float calculateTurningAnglePerMeter(float wheelBase, float turningAngle, float width) {
     /* according to https://calculator.academy/turning-radius-calculator/ and
@@ -99,20 +176,173 @@ struct {
     bool buttonPressed[4] = {false, false, false, false};
 } sInput;
 
+/* print statistics of the renderer subsystems */
+void sceneReport() {
+    const StreamBuffer &stream = sScene.stream;
+    std::cout << "[Stream] " << (stream.persistent ? "persistent" : "unsynchronized map") << ", "
+              << stream.lastFrameBytes << " bytes/frame, " << stream.stalls << " stalls ("
+              << stream.stallSeconds * 1000.0 << " ms)" << std::endl;
+
+    ResourceStats resources = resourceStats();
+    std::cout << "[Resources] " << resources.live[ResourceBuffer] << " buffers ("
+              << resources.bufferBytes / 1024 << " KiB), " << resources.live[ResourceVertexArray] << " vertex arrays, "
+              << resources.live[ResourceProgram] << " programs, " << resources.pendingDeletes << " pending deletes, "
+              << resources.pooledNames << " pooled names" << std::endl;
+
+    GLStateCounters calls = glStateLastFrame();
+    std::cout << "[GLState] " << calls.issued << " state calls issued, " << calls.skipped << " skipped last frame" << std::endl;
+
+    const LinearArena &staging = arenaStaging();
+    std::cout << "[Staging] " << staging.capacity / 1024 << " KiB arena, peak " << staging.highWater / 1024
+              << " KiB, " << staging.overflows << " overflows" << std::endl;
+
+    const RenderQueueStats &queue = sScene.queue.lastFrame;
+    std::cout << "[RenderQueue] " << queue.packets << " packets, " << queue.batches << " batches, "
+              << queue.programChanges << " program changes last frame" << std::endl;
+
+    ScreenshotStats screenshots = screenshotStats();
+    std::cout << "[Screenshot] " << screenshots.reading << " reading back, " << screenshots.encoding << " encoding, "
+              << screenshots.written << " written" << std::endl;
+
+    RecordingStats recording = recordingStats();
+    std::cout << "[Recorder] " << (recording.active ? "recording, " : "idle, ") << recording.frames << " frames written, "
+              << recording.stalls << " stalls (" << recording.stallSeconds * 1000.0 << " ms)" << std::endl;
+
+    /* process CPU time (all threads) per wall time since the last report, 100% is one busy core */
+    double wallTime = glfwGetTime();
+    std::clock_t cpuTime = std::clock();
+    double cpuUsage = 100.0 * (cpuTime - sScene.reportCpuTime) / CLOCKS_PER_SEC / (wallTime - sScene.reportWallTime);
+    std::cout << "[Idle] " << (sScene.idleMode ? "on demand, " : "continuous, ") << sScene.framesDrawn << " frames drawn, "
+              << sScene.framesSkipped << " skipped, " << cpuUsage << "% CPU since last report" << std::endl;
+    sScene.framesDrawn = 0;
+    sScene.framesSkipped = 0;
+    sScene.reportWallTime = wallTime;
+    sScene.reportCpuTime = cpuTime;
+
+    std::cout << "[Impostor] " << sScene.carsAsMesh << " cars as mesh, " << sScene.carImpostor.lastFrameInstances
+              << " as impostor below " << sScene.impostorPixels << " pixels" << std::endl;
+
+    const GpuCull &crates = sScene.crates;
+    std::cout << "[GpuCull] " << crates.instances.size() << " crates culled on the " << (crates.compute ? "GPU" : "CPU");
+    if (!crates.compute) {
+        std::cout << ", " << crates.lastFrameVisible << " visible last frame";
+    }
+    std::cout << std::endl;
+
+    const RenderGraphStats &graph = sScene.graph.lastFrame;
+    std::cout << "[RenderGraph] " << graph.passes << " passes (" << graph.culled << " culled), " << graph.transients
+              << " transient textures in " << graph.textures << " pool textures (" << graph.textureBytes / 1024
+              << " of " << graph.transientBytes / 1024 << " KiB), " << graph.barriers << " barriers" << std::endl;
+
+    const RenderScale &scale = sScene.renderScale;
+    std::cout << "[RenderScale] " << static_cast<int>(scale.scale * 100.0f + 0.5f) << "% (" << renderScaleWidth(scale)
+              << "x" << renderScaleHeight(scale) << "), GPU " << scale.gpuMs << " ms of " << scale.budgetMs
+              << " ms budget, " << scale.changes << " changes" << std::endl;
+
+    const FramePacer &pacer = sScene.pacer;
+    FramePacerStats pacing = framePacerStats(sScene.pacer);
+    std::cout << "[FramePacer] swap interval " << pacer.swapInterval << ", limit " << pacer.targetFps << " fps, "
+              << pacer.maxFramesInFlight << " frames in flight, input to GPU done " << pacing.latencyMs << " ms (max "
+              << pacing.maxLatencyMs << " ms), waited " << pacing.gpuWaitMs << " ms for the GPU and "
+              << pacing.limiterMs << " ms in the limiter over " << pacing.frames << " frames" << std::endl;
+
+    DebugLogStats log = debugLogStats();
+    std::cout << "[DebugLog] " << log.received << " driver messages, " << log.dropped << " dropped" << std::endl;
+}
+
+/* count from the environment, malformed values are ignored and large ones clamped so stress tests can't crash mid-frame */
+static unsigned long sceneEnvCount(const char *name, unsigned long max) {
+    const char *value = std::getenv(name);
+    if (!value) {
+        return 0;
+    }
+
+    char *end = nullptr;
+    unsigned long count = std::strtoul(value, &end, 10);
+    if (end == value || *end != '\0' || value[0] == '-') {
+        std::cerr << "[Scene] Ignoring " << name << "=" << value << ", expected a count" << std::endl;
+        return 0;
+    }
+    if (count > max) {
+        std::cerr << "[Scene] " << name << "=" << value << " clamped to " << max << std::endl;
+        return max;
+    }
+    return count;
+}
+
+/* request a new frame after input or the window changed something visible */
+static void sceneInvalidate() {
+    sScene.redraw = true;
+}
+
+/* whether the next frame has to be drawn, also while nothing changed but work depends on further frames */
+static bool sceneNeedsFrame() {
+    if (sScene.redraw || !sScene.idleMode || recordingActive()) {
+        return true;
+    }
+
+    /* held movement keys and mouse drags animate every frame, not only when a key repeat event arrives */
+    for (bool pressed : sInput.buttonPressed) {
+        if (pressed) {
+            return true;
+        }
+    }
+    if (sInput.mouseLeftButtonPressed) {
+        return true;
+    }
+
+    /* captures are read back and released on the following frames */
+    ScreenshotStats screenshots = screenshotStats();
+    if (screenshots.reading || screenshots.encoding) {
+        return true;
+    }
+
+    /* variants in use are swapped in by shaderPermutationSelect once they are built */
+    for (uint32_t featureMask : {sScene.groundFeatures, static_cast<uint32_t>(eShaderFeature::MatrixPalette),
+                                 static_cast<uint32_t>(eShaderFeature::MatrixPalette | eShaderFeature::Dither)}) {
+        auto variant = sScene.shaderColor.variants.find(featureMask);
+        if (variant != sScene.shaderColor.variants.end() && variant->second.building.id) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /* GLFW callback function for keyboard events */
 void callbackKey(GLFWwindow *window, int key, int scancode, int action, int mods) {
     /* called on keyboard event */
+    sceneInvalidate();
 
     /* close window on escape */
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
 
-    /* make screenshot and save in work directory */
+    /* make screenshot of the next frame and save in work directory (encoded in the background) */
     if (key == GLFW_KEY_P && action == GLFW_PRESS) {
         screenshotToPNG("screenshot.png");
     }
 
+    /* start/stop recording every frame to recording.y4m (or the target given by RECORD) */
+    if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        if (recordingActive()) {
+            recordingStop();
+        } else {
+            const char *target = std::getenv("RECORD");
+            recordingStart(target ? target : "recording.y4m");
+        }
+    }
+
+    /* toggle checkerboard ground */
+    if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        sScene.groundFeatures ^= eShaderFeature::Checkerboard;
+    }
+
+    /* print renderer statistics */
+    if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+        sceneReport();
+    }
+
     /* input for car control */
     if (key == GLFW_KEY_W) {
         sInput.buttonPressed[0] = (action == GLFW_PRESS || action == GLFW_REPEAT);
@@ -165,6 +395,7 @@ void callbackMousePos(GLFWwindow *window, double x, double y) {
         Vector2D diff = sInput.mousePressStart - Vector2D(x, y);
         cameraUpdateOrbit(sScene.camera, diff, 0.0f);
         sInput.mousePressStart = Vector2D(x, y);
+        sceneInvalidate();
     }
 }
 
@@ -182,6 +413,7 @@ void callbackMouseButton(GLFWwindow *window, int button, int action, int mods) {
 /* GLFW callback function for mouse scroll events */
 void callbackMouseScroll(GLFWwindow *window, double xoffset, double yoffset) {
     cameraUpdateOrbit(sScene.camera, {0, 0}, -sScene.zoomSpeedMultiplier * yoffset);
+    sceneInvalidate();
 }
 
 /* GLFW callback function for window resize event */
@@ -189,6 +421,13 @@ void callbackWindowResize(GLFWwindow *window, int width, int height) {
     glViewport(0, 0, width, height);
     sScene.camera.width = width;
     sScene.camera.height = height;
+    renderScaleResize(sScene.renderScale, width, height);
+    sceneInvalidate();
+}
+
+/* GLFW callback function for window refresh events (window exposed or damaged) */
+void callbackWindowRefresh(GLFWwindow *window) {
+    sceneInvalidate();
 }
 
 /* function to setup and initialize the whole scene */
@@ -200,26 +439,43 @@ void sceneInit(float width, float height) {
     sScene.cameraChaseMode = false;
     sScene.zoomSpeedMultiplier = 0.05f;
 
+    /* headless runs render every frame, IDLE=0 keeps redrawing every vsync interval for comparison */
+    const char *idle = std::getenv("IDLE");
+    sScene.idleMode = !windowHeadless() && !(idle && std::string(idle) == "0");
+    sScene.redraw = true;
+    sScene.framesDrawn = 0;
+    sScene.framesSkipped = 0;
+    sScene.reportWallTime = glfwGetTime();
+    sScene.reportCpuTime = std::clock();
+
     sScene.carTransformationMatrix = Matrix4D::identity();
     sScene.lastMovementDirection = -1.0f; // start assuming forward direction
 
 
     /* setup objects in scene and create opengl buffers for meshes */
-    sScene.ground = groundCreate({0.15f, 0.35f, 0.15f});
+    sScene.geometry = megaBufferCreate(1 << 16, 1 << 18);
+    sScene.stream = streamBufferCreate(SCENE_STREAM_SIZE);
+    sScene.ground = groundCreate(sScene.geometry, {0.15f, 0.35f, 0.15f});
 
     /* car */
     sScene.carTransformationMatrix = Matrix4D::identity();
 
-    /* cubes */
-    sScene.baseCarMesh = meshCreate(cube::vertices, cube::indices,GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.windowCarMesh = meshCreate(cube::vertices, cube::indices,GL_STATIC_DRAW, GL_STATIC_DRAW);
+    /* optimize the car geometry for the vertex cache once at load time */
+    std::vector<Vertex> cubeVertices = cube::vertices;
+    std::vector<unsigned int> cubeIndices = cube::indices;
+    meshOptimize(cubeVertices, cubeIndices, "cube");
 
-    /* cylinders */
-    sScene.bottomLeftWheelMesh = meshCreate(cylinder::vertexPos, cylinder::indices, {0.3f, 0.3f, 0.3f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.bottomRightWheelMesh = meshCreate(cylinder::vertexPos, cylinder::indices, {0.3f, 0.3f, 0.3f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.topLeftWheelMesh = meshCreate(cylinder::vertexPos, cylinder::indices, {0.3f, 0.3f, 0.3f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.topRightWheelMesh = meshCreate(cylinder::vertexPos, cylinder::indices, {0.3f, 0.3f, 0.3f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    sScene.spareWheelMesh = meshCreate(cylinder::vertexPos, cylinder::indices, {0.3f, 0.3f, 0.3f, 1.0f}, GL_STATIC_DRAW, GL_STATIC_DRAW);
+    std::vector<Vector3D> cylinderPositions = cylinder::vertexPos;
+    std::vector<unsigned int> cylinderIndices = cylinder::indices;
+    meshOptimize(cylinderPositions, cylinderIndices, "cylinder");
+
+    /* the parts never move independently of the car, so they share one buffer and draw (order as in eCarPart) */
+    StaticBatchPart cubePart = {cubeVertices, cubeIndices};
+    StaticBatchPart wheelPart = staticBatchPart(cylinderPositions, cylinderIndices, {0.3f, 0.3f, 0.3f, 1.0f});
+    sScene.car = staticBatchCreate({cubePart, cubePart, wheelPart, wheelPart, wheelPart, wheelPart, wheelPart});
+
+    /* the scene meshes are one load batch, release their staging data */
+    arenaReset(arenaStaging());
 
     /* setup transformation matrices for objects */
 
@@ -264,8 +520,85 @@ void sceneInit(float width, float height) {
 
     sScene.frontWheelSpinAccumulator = 0.0f;
 
-    /* load shader from file */
-    sScene.shaderColor = shaderLoad("../../src/shader/default.vert", "../../src/shader/default.frag");
+    /* create shader from the sources embedded at build time */
+    sScene.shaderColor = shaderPermutationsCreate(shaderSource("default.vert"), shaderSource("default.frag"), {"CHECKERBOARD", "PALETTE", "DITHER"});
+    shaderPermutation(sScene.shaderColor, 0);
+    shaderPermutation(sScene.shaderColor, eShaderFeature::MatrixPalette);
+    shaderPermutationsPrecompile(sScene.shaderColor, {eShaderFeature::Checkerboard});
+    sScene.groundFeatures = 0;
+
+    /* bounding sphere of the car at rest, from the part vertices moved by their palette entries */
+    sceneCarPalette();
+    sScene.carRestPalette = sScene.car.palette;
+    Vector3D boundsMin(1e30f, 1e30f, 1e30f);
+    Vector3D boundsMax(-1e30f, -1e30f, -1e30f);
+    for (int part = 0; part < CarPartCount; part++) {
+        bool body = part == CarBase || part == CarWindow;
+        for (const Vector3D &position : body ? cube::vertexPos : cylinder::vertexPos) {
+            Vector3D p = Vector3D(sScene.carRestPalette[part] * Vector4D(position, 1.0f));
+            boundsMin = Vector3D(std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z));
+            boundsMax = Vector3D(std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z));
+        }
+    }
+    Vector3D boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    float boundsRadius = length(boundsMax - boundsCenter);
+
+    /* IMPOSTOR_PIXELS is the projected size below which a car becomes an impostor, 0 always draws meshes */
+    const char *impostorPixels = std::getenv("IMPOSTOR_PIXELS");
+    sScene.impostorPixels = impostorPixels ? std::stof(impostorPixels) : 48.0f;
+    sScene.carImpostor = impostorAtlasCreate(sScene.stream, boundsCenter, boundsRadius, sceneDrawCarRest, nullptr);
+    shaderPermutationsPrecompile(sScene.shaderColor, {eShaderFeature::MatrixPalette | eShaderFeature::Dither});
+    sScene.carsAsMesh = 0;
+    sScene.fadeProgram = 0;
+
+    /* PARKED_CARS=n adds static cars on a grid around the start, to see the impostors pay off when zoomed out */
+    unsigned int parkedCount = static_cast<unsigned int>(sceneEnvCount("PARKED_CARS", SCENE_MAX_PARKED_CARS));
+    unsigned int parkedColumns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<float>(parkedCount))));
+    for (unsigned int i = 0; i < parkedCount; i++) {
+        float x = 8.0f * (static_cast<float>(i % parkedColumns) - 0.5f * (parkedColumns - 1));
+        float z = 12.0f + 8.0f * static_cast<float>(i / parkedColumns);
+        sScene.parkedCars.push_back(Matrix4D::translation({x, 0.0f, z}));
+    }
+
+    /* CRATES=n scatters crates over the ground as a stress test for instance culling, CULL_CPU=1 culls them on the CPU */
+    unsigned long crateCount = sceneEnvCount("CRATES", SCENE_MAX_CRATES);
+    const char *cullCpu = std::getenv("CULL_CPU");
+    sScene.crateMesh = meshCreate(sScene.geometry, cube::vertexPos, cube::indices, {0.55f, 0.4f, 0.25f, 1.0f});
+    std::vector<Matrix4D> crateModels;
+    crateModels.reserve(crateCount);
+    std::mt19937 random(42);
+    std::uniform_real_distribution<float> position(-19.0f, 19.0f);
+    std::uniform_real_distribution<float> size(0.1f, 0.4f);
+    std::uniform_real_distribution<float> angle(0.0f, 2.0f * static_cast<float>(M_PI));
+    for (unsigned long i = 0; i < crateCount; i++) {
+        Vector3D base(position(random), 0.0f, position(random));
+        float halfSize = size(random);
+        base.y = groundGetHeightAt(sScene.ground, base) + halfSize;
+        crateModels.push_back(Matrix4D::translation(base) * Matrix4D::rotationY(angle(random)) *
+                              Matrix4D::scale(halfSize, halfSize, halfSize));
+    }
+    sScene.crates = gpuCullCreate(sScene.crateMesh, crateModels, cullCpu && std::string(cullCpu) == "1");
+
+    /* rebuild the shaders when their sources are saved */
+    sScene.shaderWatcher = shaderWatcherCreate();
+
+    sScene.queue = renderQueueCreate();
+    sScene.queue.bindDraw = sceneBindCarDraw;
+    sScene.graph = renderGraphCreate();
+
+    /* SWAP_INTERVAL=0 is uncapped (-1 adaptive), FPS_LIMIT caps the frame rate, FRAMES_IN_FLIGHT trades latency
+     * (fewer) against throughput (more) */
+    const char *swapInterval = std::getenv("SWAP_INTERVAL");
+    const char *fpsLimit = std::getenv("FPS_LIMIT");
+    const char *framesInFlight = std::getenv("FRAMES_IN_FLIGHT");
+    sScene.pacer = framePacerCreate(swapInterval ? std::stoi(swapInterval) : 1, fpsLimit ? std::stod(fpsLimit) : 0.0,
+                                    framesInFlight ? static_cast<unsigned int>(std::stoul(framesInFlight)) : 2);
+
+    /* RENDER_SCALE_MIN=1 renders at full resolution, RENDER_SCALE_BUDGET is the GPU time per frame in ms */
+    const char *minScale = std::getenv("RENDER_SCALE_MIN");
+    const char *budget = std::getenv("RENDER_SCALE_BUDGET");
+    sScene.renderScale = renderScaleCreate(static_cast<int>(width), static_cast<int>(height),
+                                           minScale ? std::stof(minScale) : 0.5f, budget ? std::stof(budget) : 16.7f);
 
 }
 
@@ -484,9 +817,28 @@ void updateCarRotation(const Matrix4D& rotationMatrix)
     sScene.carTransformationMatrix = rotationMatrix * sScene.carTransformationMatrix;
 }
 
+/* rebuilds the shader variants in the background when default.vert or default.frag were saved */
+static void sceneReloadShaders() {
+    for (const std::string &name : shaderWatcherPoll(sScene.shaderWatcher)) {
+        if (name != "default.vert" && name != "default.frag") {
+            continue;
+        }
+        try {
+            shaderPermutationsReload(sScene.shaderColor, shaderSourceFile("default.vert"), shaderSourceFile("default.frag"));
+            std::cout << "[Scene] Reloading shaders after " << name << " changed" << std::endl;
+            sceneInvalidate();
+        } catch (const std::runtime_error &) {
+            /* file is mid-save or was removed, keep the current programs */
+        }
+        break;
+    }
+}
+
 /* function to move and update objects in scene (e.g., move car according to user input) */
 void sceneUpdate(float dt) {
 
+    sceneReloadShaders();
+
     /* constants */
     const float frontWheelRadius = 0.35f; 
     const float rearWheelRadius = 0.5f;    
@@ -513,6 +865,7 @@ void sceneUpdate(float dt) {
 
     /* update forward movement */
     if (forwardMovement != 0) {
+        sceneInvalidate();
         sScene.lastMovementDirection = forwardMovement;
         /* direction in local space */
         Vector3D forward = {0.0f, 0.0f, -1.0f};
@@ -602,87 +955,179 @@ void sceneUpdate(float dt) {
     }
 }
 
-/* function to draw all objects in the scene */
-void sceneDraw() {
-    /* clear framebuffer color */
-    glClearColor(135.0f / 255, 206.0f / 255, 235.0f / 255, 1.0);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    /*------------ render scene -------------*/
-    glUseProgram(sScene.shaderColor.id);
-    shaderUniform(sScene.shaderColor, "uProj", cameraProjection(sScene.camera));
-    shaderUniform(sScene.shaderColor, "uView", cameraView(sScene.camera));
-
-    /* draw ground */
-    shaderUniform(sScene.shaderColor, "uModel", Matrix4D::identity());
-    glBindVertexArray(sScene.ground.mesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.ground.mesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* ---------- cubes ---------- */
+/* records a draw of a mesh at the coarsest LOD that stays below one pixel of error */
+static void sceneDrawMesh(const Mesh &mesh, const Matrix4D &model, GLuint program) {
+    DrawPacket packet;
+    packet.mesh = &mesh;
+    packet.program = program;
+    packet.lod = static_cast<uint8_t>(meshSelectLod(mesh, model, sScene.camera));
+    packet.depth = length(Vector3D(model * Vector4D(mesh.boundsCenter, 1.0f)) - sScene.camera.position);
+    packet.model = model;
+    renderQueueSubmit(sScene.queue, 0, packet);
+}
 
-    /* base car */
-    shaderUniform(sScene.shaderColor, "uModel",
+/* car parts are animated through their palette entries, the whole car is one draw */
+static void sceneCarPalette() {
+    sScene.car.palette[CarBase] =
         sScene.baseCarTranslationMatrix *
         sScene.baseCarTransformationMatrix *
-        sScene.baseCarScalingMatrix);
-    glBindVertexArray(sScene.baseCarMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.baseCarMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* window car */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.baseCarScalingMatrix;
+    sScene.car.palette[CarWindow] =
         sScene.windowCarTranslationMatrix *
         sScene.windowCarTransformationMatrix *
-        sScene.windowCarScalingMatrix);
-    glBindVertexArray(sScene.windowCarMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.windowCarMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* ---------- cylinders ---------- */
-
-    /* bottom left wheel */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.windowCarScalingMatrix;
+    sScene.car.palette[CarBottomLeftWheel] =
         sScene.bottomLeftWheelTranslationMatrix *
         sScene.bottomLeftWheelTransformationMatrix *
-        sScene.bottomLeftWheelScalingMatrix);
-    glBindVertexArray(sScene.bottomLeftWheelMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bottomLeftWheelMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* bottom right wheel */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.bottomLeftWheelScalingMatrix;
+    sScene.car.palette[CarBottomRightWheel] =
         sScene.bottomRightWheelTranslationMatrix *
         sScene.bottomRightWheelTransformationMatrix *
-        sScene.bottomRightWheelScalingMatrix);
-    glBindVertexArray(sScene.bottomRightWheelMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.bottomRightWheelMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* top left wheel */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.bottomRightWheelScalingMatrix;
+    sScene.car.palette[CarTopLeftWheel] =
         sScene.topLeftWheelTranslationMatrix *
         sScene.topLeftWheelTransformationMatrix *
-        sScene.topLeftWheelScalingMatrix);
-    glBindVertexArray(sScene.topLeftWheelMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.topLeftWheelMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* top right wheel */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.topLeftWheelScalingMatrix;
+    sScene.car.palette[CarTopRightWheel] =
         sScene.topRightWheelTranslationMatrix *
         sScene.topRightWheelTransformationMatrix *
-        sScene.topRightWheelScalingMatrix);
-    glBindVertexArray(sScene.topRightWheelMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.topRightWheelMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
-
-    /* spare wheel */
-    shaderUniform(sScene.shaderColor, "uModel",
+        sScene.topRightWheelScalingMatrix;
+    sScene.car.palette[CarSpareWheel] =
         sScene.spareWheelTranslationMatrix *
         sScene.spareWheelTransformationMatrix *
-        sScene.spareWheelScalingMatrix);
-    glBindVertexArray(sScene.spareWheelMesh.vao);
-    glDrawElements(GL_TRIANGLES, sScene.spareWheelMesh.size_ibo, GL_UNSIGNED_INT, nullptr);
+        sScene.spareWheelScalingMatrix;
+}
+
+/* sets the cross-fade of a car drawn by the render queue, params.x is its fade */
+static void sceneBindCarDraw(GLuint program, const DrawPacket &packet) {
+    if (packet.params.x <= 0.0f) {
+        return;
+    }
+
+    /* resolved again when the DITHER variant is swapped in, the fallback while it builds has no uFade */
+    if (sScene.fadeProgram != program) {
+        const ShaderProgram &variant = shaderPermutationSelect(sScene.shaderColor,
+                                                               eShaderFeature::MatrixPalette | eShaderFeature::Dither,
+                                                               eShaderFeature::MatrixPalette);
+        auto uniform = variant.uniforms.find("uFade");
+        sScene.fadeProgram = program;
+        sScene.fadeUniform = variant.id == program && uniform != variant.uniforms.end() ? uniform->second
+                                                                                        : UniformHandle();
+    }
+    if (sScene.fadeUniform.location >= 0) {
+        shaderUniform(sScene.fadeUniform, packet.params.x);
+    }
+}
+
+/* records one car as mesh, impostor or both while it crosses the size threshold, without a palette the rest pose
+ * is moved by the model matrix */
+static void sceneDrawCar(const Matrix4D &model, const Matrix4D *palette) {
+    float fade = impostorFade(sScene.carImpostor, model, sScene.camera, sScene.impostorPixels);
+    if (fade < 1.0f) {
+        if (!palette) {
+            /* the queue reads the palette when it executes, the staging arena is released after the frame */
+            Matrix4D *moved = arenaAllocArray<Matrix4D>(arenaStaging(), CarPartCount);
+            for (int part = 0; part < CarPartCount; part++) {
+                moved[part] = model * sScene.carRestPalette[part];
+            }
+            palette = moved;
+        }
+
+        /* while cross-fading the mesh leaves the pixels of the impostor's dither pattern */
+        uint32_t features = fade > 0.0f ? eShaderFeature::MatrixPalette | eShaderFeature::Dither
+                                        : eShaderFeature::MatrixPalette;
+        DrawPacket packet;
+        packet.kind = PaletteBatchDraw;
+        packet.batch = &sScene.car;
+        packet.palette = palette;
+        packet.paletteCount = CarPartCount;
+        packet.program = shaderPermutationSelect(sScene.shaderColor, features, eShaderFeature::MatrixPalette).id;
+        packet.depth = length(Vector3D(model * Vector4D(sScene.carImpostor.center, 1.0f)) - sScene.camera.position);
+        packet.params = Vector4D(fade, 0.0f, 0.0f, 0.0f);
+        renderQueueSubmit(sScene.queue, 0, packet);
+        sScene.carsAsMesh++;
+    }
+    if (fade > 0.0f) {
+        impostorSubmit(sScene.carImpostor, model, fade);
+    }
+}
+
+/* draws the car in its rest pose into the impostor atlas */
+static void sceneDrawCarRest(void *user) {
+    glStateUseProgram(shaderPermutation(sScene.shaderColor, eShaderFeature::MatrixPalette).id);
+    staticBatchDraw(sScene.car, sScene.carRestPalette.data(), CarPartCount, sScene.stream);
+}
+
+/* render graph pass drawing all objects in the scene */
+static void sceneDrawPass(RenderGraph &graph, const GraphPass &pass, void *user) {
+    /* clear framebuffer color */
+    glClearColor(135.0f / 255, 206.0f / 255, 235.0f / 255, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    /*------------ render scene -------------*/
+    /* camera data shared by all programs through the PerFrame uniform block */
+    PerFrameBlock frame;
+    frame.view = cameraView(sScene.camera);
+    frame.proj = cameraProjection(sScene.camera);
+    frame.viewProj = frame.proj * frame.view;
+    frame.cameraPosition = Vector4D(sScene.camera.position, 1.0f);
+    frame.time = static_cast<float>(glfwGetTime());
+    uniformBlockUpload(sScene.stream, eUniformBlockBinding::PerFrame, &frame, sizeof(frame));
+
+    /* cull the crates before any draw program is bound, the draw below waits for the result on the GPU */
+    gpuCullDispatch(sScene.crates, sScene.camera);
+
+    /* the moving car keeps its animated palette, parked ones are moved copies of the rest pose */
+    sceneCarPalette();
+    Matrix4D carModel = sScene.car.palette[CarBase] * inverse(sScene.carRestPalette[CarBase]);
+    sScene.carsAsMesh = 0;
+    sceneDrawCar(carModel, sScene.car.palette.data());
+    for (const Matrix4D &parked : sScene.parkedCars) {
+        sceneDrawCar(parked, nullptr);
+    }
+
+    /* ground uses its own shader variant */
+    GLuint groundProgram = shaderPermutationSelect(sScene.shaderColor, sScene.groundFeatures).id;
+    sceneDrawMesh(sScene.ground.mesh, Matrix4D::identity(), groundProgram);
+
+    /* crates are counted on the GPU, their indirect draw can't be sorted with the recorded packets */
+    glStateUseProgram(shaderPermutationSelect(sScene.shaderColor, 0).id);
+    gpuCullDraw(sScene.crates, sScene.geometry);
+
+    /* sort and issue all recorded draws */
+    renderQueueExecute(sScene.queue, sScene.stream);
+
+    /* all distant cars in one instanced draw */
+    impostorDraw(sScene.carImpostor, sScene.stream);
+}
+
+/* function to draw all objects in the scene */
+void sceneDraw() {
+    /* render the scene at the current dynamic resolution */
+    renderScaleBegin(sScene.renderScale);
+
+    /* the scene pass renders into the (scaled) output, later passes declare their reads and writes the same way */
+    const RenderScale &scale = sScene.renderScale;
+    renderGraphBegin(sScene.graph);
+    GraphResource output = renderGraphImport(sScene.graph, "scene output", renderScaleFramebuffer(scale),
+                                             renderScaleWidth(scale), renderScaleHeight(scale));
+    renderGraphAddPass(sScene.graph, "scene", {}, {output}, sceneDrawPass);
+    renderGraphExecute(sScene.graph);
+
+    /* scale up to the window, anything drawn after this (e.g. UI) is at native resolution */
+    renderScaleEnd(sScene.renderScale);
+
+    /* fence this frame's streamed data and released objects */
+    streamBufferFrameEnd(sScene.stream);
+    resourceFrameEnd();
+
+    /* temporary data of this frame is not needed anymore */
+    arenaReset(arenaStaging());
 
     glCheckError();
 
-    /* cleanup opengl state */
-    glBindVertexArray(0);
-    glUseProgram(0);
+    /* bindings stay in place for the next frame, the state cache skips rebinding them */
+    glStateFrameEnd();
 }
 
 int main(int argc, char **argv) {
@@ -694,44 +1139,85 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
+    /* actual size, headless mode may override it */
+    glfwGetFramebufferSize(window, &width, &height);
+
     /* set window callbacks */
     glfwSetKeyCallback(window, callbackKey);
     glfwSetCursorPosCallback(window, callbackMousePos);
     glfwSetMouseButtonCallback(window, callbackMouseButton);
     glfwSetScrollCallback(window, callbackMouseScroll);
     glfwSetFramebufferSizeCallback(window, callbackWindowResize);
+    glfwSetWindowRefreshCallback(window, callbackWindowRefresh);
 
     /*---------- init opengl stuff ------------*/
-    glEnable(GL_DEPTH_TEST);
+    glStateEnable(GL_DEPTH_TEST, true);
 
     /* setup scene */
     sceneInit(width, height);
 
+    /* record from the first frame, e.g. for regression videos of headless runs */
+    if (const char *target = std::getenv("RECORD")) {
+        recordingStart(target);
+    }
+
     /*-------------- main loop ----------------*/
     double timeStamp = glfwGetTime();
     double timeStampNew = 0.0;
 
     /* loop until user closes window */
     while (!glfwWindowShouldClose(window)) {
-        /* poll and process input and window events */
-        glfwPollEvents();
+        /* poll and process input and window events, sleep until the next event if nothing changed */
+        if (sceneNeedsFrame()) {
+            /* wait for the GPU and the frame limiter first, so input is polled as late as possible */
+            framePacerWait(sScene.pacer);
+            glfwPollEvents();
+        } else {
+            framePacerDrain(sScene.pacer);
+            glfwWaitEventsTimeout(idleWaitSeconds);
+
+            /* nothing was animating before the sleep, so the time spent in it doesn't count as movement */
+            timeStamp = glfwGetTime();
+        }
 
         /* update camera and model matrices */
         timeStampNew = glfwGetTime();
         sceneUpdate(timeStampNew - timeStamp);
         timeStamp = timeStampNew;
 
+        if (!sceneNeedsFrame()) {
+            sScene.framesSkipped++;
+            continue;
+        }
+        sScene.redraw = false;
+        sScene.framesDrawn++;
+
         /* draw all objects in the scene */
         sceneDraw();
 
-        /* swap front and back buffer */
-        glfwSwapBuffers(window);
+        /* swap front and back buffer (counts the frame in headless mode) */
+        windowSwapBuffers(window);
+        framePacerFrameEnd(sScene.pacer);
     }
 
     /*-------- cleanup --------*/
     /* delete opengl shader and buffers */
-    shaderDelete(sScene.shaderColor);
+    impostorAtlasDelete(sScene.carImpostor);
+    shaderPermutationsDelete(sScene.shaderColor);
+    shaderWatcherDelete(sScene.shaderWatcher);
+    renderQueueDelete(sScene.queue);
+    renderScaleDelete(sScene.renderScale);
+    renderGraphDelete(sScene.graph);
+    framePacerDelete(sScene.pacer);
     groundDelete(sScene.ground);
+    staticBatchDelete(sScene.car);
+    gpuCullDelete(sScene.crates);
+    meshDelete(sScene.crateMesh);
+    megaBufferDelete(sScene.geometry);
+    streamBufferDelete(sScene.stream);
+
+    /* delete everything still queued before the context goes away */
+    resourceShutdown();
 
     /* cleanup glfw/glcontext */
     windowDelete(window);
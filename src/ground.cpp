@@ -1,10 +1,12 @@
 #include "ground.h"
 #include "mygl/geometry.h"
+#include "mygl/meshlod.h"
+#include "mygl/meshopt.h"
 
 // forward declaration so computeWaveHeight can be called before its definition
 static float computeWaveHeight(const Ground &ground, const Vector3D &pos);
 
-Ground groundCreate(const Vector3D &color) {
+Ground groundCreate(MegaBuffer &pool, const Vector3D &color) {
     Ground ground;
     ground.vertices.resize(grid::vertexPos.size());
 
@@ -41,7 +43,12 @@ Ground groundCreate(const Vector3D &color) {
         ground.vertices[i].color = lowColor * (1.0f - t) + highColor * t;
     }
 
-    ground.mesh = meshCreate(ground.vertices, grid::indices, GL_DYNAMIC_DRAW, GL_STATIC_DRAW);
+    /* reorder the grid for the post-transform cache and vertex fetch before uploading it */
+    std::vector<unsigned int> indices = grid::indices;
+    meshOptimize(ground.vertices, indices, "ground");
+
+    ground.mesh = meshCreate(pool, ground.vertices, indices);
+    meshAddLods(ground.mesh, meshGenerateLods(ground.vertices, indices));
 
     return ground;
 }
@@ -25,18 +25,18 @@ struct Ground {
  * @brief Initializes a plane grid to visualize the ground surface. For that a vector containing all grid vertices is created and
  * a mesh (see function meshCreate(...)) is setup with these vertices.
  *
+ * @param pool Mega buffer from which the ground mesh is allocated.
  * @param color Color of the ground.
  *
  * @return Object containing the vector of vertices and an initialized mesh structure that can be drawn with OpenGL.
  *
  * usage:
  *
- *   Ground myGround = groundCreate({0.15f, 0.45f, 0.15f});
- *   glBindVertexArray(myGround.mesh.vao);
- *   glDrawElements(GL_TRIANGLES, myGround.size_ibo, GL_UNSIGNED_INT, nullptr);
+ *   Ground myGround = groundCreate(pool, {0.15f, 0.45f, 0.15f});
+ *   megaBufferDrawAdd(pool, myGround.mesh, Matrix4D::identity());
  *
  */
-Ground groundCreate(const Vector3D &color);
+Ground groundCreate(MegaBuffer &pool, const Vector3D &color);
 
 
 /**
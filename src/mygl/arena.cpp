@@ -0,0 +1,80 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#define ARENA_STAGING_CAPACITY (1u << 20)
+
+namespace detail
+{
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+LinearArena arenaCreate(size_t capacity)
+{
+    LinearArena arena;
+    arena.data = new unsigned char[capacity];
+    arena.capacity = capacity;
+    return arena;
+}
+
+void arenaDelete(LinearArena& arena)
+{
+    for(unsigned char* block : arena.overflow)
+    {
+        delete[] block;
+    }
+    delete[] arena.data;
+    arena = LinearArena();
+}
+
+void* arenaAlloc(LinearArena& arena, size_t size, size_t alignment)
+{
+    uintptr_t base = reinterpret_cast<uintptr_t>(arena.data);
+    size_t offset = detail::alignUp(base + arena.head, alignment) - base;
+    if(offset + size <= arena.capacity)
+    {
+        arena.head = offset + size;
+        arena.highWater = std::max(arena.highWater, arena.head + arena.overflowBytes);
+        return arena.data + offset;
+    }
+
+    /* block exhausted, serve from the heap until the next reset */
+    unsigned char* block = new unsigned char[size + alignment];
+    arena.overflow.push_back(block);
+    arena.overflowBytes += size + alignment;
+    arena.highWater = std::max(arena.highWater, arena.head + arena.overflowBytes);
+    arena.overflows++;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(block);
+    return block + (detail::alignUp(address, alignment) - address);
+}
+
+void arenaReset(LinearArena& arena)
+{
+    for(unsigned char* block : arena.overflow)
+    {
+        delete[] block;
+    }
+    arena.overflow.clear();
+
+    /* grow once to the peak usage so the overflow doesn't repeat */
+    if(arena.overflowBytes > 0)
+    {
+        delete[] arena.data;
+        arena.capacity = detail::alignUp(arena.highWater, 4096);
+        arena.data = new unsigned char[arena.capacity];
+        arena.overflowBytes = 0;
+    }
+
+    arena.head = 0;
+}
+
+LinearArena& arenaStaging()
+{
+    thread_local LinearArena arena = arenaCreate(ARENA_STAGING_CAPACITY);
+    return arena;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/* bump allocator for short-lived data, everything is released at once by arenaReset */
+struct LinearArena
+{
+    unsigned char* data = nullptr;
+    size_t capacity = 0;
+    size_t head = 0;
+
+    /* blocks taken from the heap after the arena ran full, freed on reset */
+    std::vector<unsigned char*> overflow;
+    size_t overflowBytes = 0;
+
+    /* statistics */
+    size_t highWater = 0;
+    unsigned int overflows = 0;
+};
+
+/**
+ * @brief Creates a linear arena with one preallocated block.
+ *
+ * @param capacity Size of the block in bytes.
+ *
+ * @return Initialized arena.
+ *
+ * usage:
+ *
+ *   LinearArena arena = arenaCreate(1 << 20);
+ *   Vertex* vertices = arenaAllocArray<Vertex>(arena, count);
+ *   ...
+ *   arenaReset(arena);
+ */
+LinearArena arenaCreate(size_t capacity);
+
+/**
+ * @brief Frees the block and all overflow allocations of an arena.
+ *
+ * @param arena Arena to delete.
+ */
+void arenaDelete(LinearArena& arena);
+
+/**
+ * @brief Allocates memory from an arena. Never fails, if the block is exhausted the memory is taken from the heap and
+ * the block grows to the peak usage on the next reset, so the steady state doesn't allocate.
+ *
+ * @param arena Arena to allocate from.
+ * @param size Size in bytes.
+ * @param alignment Alignment in bytes (power of two).
+ *
+ * @return Uninitialized memory valid until the next arenaReset(...).
+ */
+void* arenaAlloc(LinearArena& arena, size_t size, size_t alignment = alignof(std::max_align_t));
+
+/**
+ * @brief Allocates an uninitialized array of trivially copyable elements from an arena.
+ *
+ * @param arena Arena to allocate from.
+ * @param count Number of elements.
+ *
+ * @return Pointer to the first element.
+ */
+template<typename T>
+T* arenaAllocArray(LinearArena& arena, size_t count)
+{
+    return static_cast<T*>(arenaAlloc(arena, count * sizeof(T), alignof(T)));
+}
+
+/**
+ * @brief Releases all allocations of an arena. Has to be called once per frame or after a batch of loads.
+ *
+ * @param arena Arena to reset.
+ */
+void arenaReset(LinearArena& arena);
+
+/**
+ * @brief Returns the staging arena of the calling thread that mesh construction uses for temporary vertex data.
+ *
+ * @return Staging arena, reset with arenaReset(...) by the owner of the frame or load batch.
+ */
+LinearArena& arenaStaging();
@@ -1,10 +1,65 @@
 #include "base.h"
+#include "debuglog.h"
+#include "recorder.h"
+#include "screenshot.h"
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
-#include <stb_image/stb_image_write.h>
+#define WINDOW_HEADLESS_FRAMES 300
+
+namespace detail
+{
+    /* offscreen render target replacing the window's framebuffer in headless mode */
+    struct HeadlessTarget
+    {
+        bool enabled = false;
+        GLuint fbo = 0;
+        GLuint renderbuffers[2] = {0, 0};
+
+        unsigned long frames = 0;
+        unsigned long frameLimit = WINDOW_HEADLESS_FRAMES;
+        double startTime = 0.0;
+    };
+
+    HeadlessTarget& headless()
+    {
+        static HeadlessTarget target;
+        return target;
+    }
+
+    bool headlessRequested()
+    {
+#ifdef WINDOW_HEADLESS_ONLY
+        return true;
+#else
+        const char* value = std::getenv("HEADLESS");
+        return value && *value && std::string(value) != "0";
+#endif
+    }
+
+    bool createOffscreenTarget(HeadlessTarget& target, int width, int height)
+    {
+        glGenRenderbuffers(2, target.renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        /* stays bound, the scene renders into it like into the window */
+        glGenFramebuffers(1, &target.fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.renderbuffers[1]);
+        glViewport(0, 0, width, height);
+
+        return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+}
 
 /**
  * debugging function from Joey de Vries (LearnOpenGL)
@@ -31,24 +86,6 @@ GLenum glCheckError_(const char *file, int line)
     return errorCode;
 }
 
-void screenshotToPNG(const std::string &filepath)
-{
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-
-    int width  = viewport[2];
-    int height = viewport[3];
-    int nPixels = width * height;
-
-    std::vector<GLubyte> data(4 * nPixels);
-
-    glReadBuffer(GL_FRONT);
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
-
-    stbi_flip_vertically_on_write(true);
-    stbi_write_png(filepath.c_str(), width, height, 4, data.data(), width * 4);
-}
-
 void glfw_error_callback(int error, const char* description)
 {
     std::cerr << "GLFW Error: " <<  description << std::endl;
@@ -77,6 +114,29 @@ GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, un
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
+    /* headless: hidden window, size and frame count from the environment */
+    detail::HeadlessTarget& headless = detail::headless();
+    headless.enabled = detail::headlessRequested();
+    if(headless.enabled)
+    {
+        const char* size = std::getenv("HEADLESS_SIZE");
+        if(size && std::sscanf(size, "%ux%u", &width, &height) != 2)
+        {
+            std::cerr << "HEADLESS_SIZE has to be <width>x<height>, using " << width << "x" << height << std::endl;
+        }
+        const char* frames = std::getenv("HEADLESS_FRAMES");
+        if(frames)
+        {
+            headless.frameLimit = std::strtoul(frames, nullptr, 10);
+        }
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
+#ifndef NDEBUG
+    /* debug contexts report everything through KHR_debug, release contexts may skip validation */
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
+
     /* create window and its opengl context */
     GLFWwindow* window = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
     if(window == nullptr)
@@ -88,7 +148,7 @@ GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, un
 
     /* make context the current one */
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
+    glfwSwapInterval(headless.enabled ? 0 : 1);
 
     /*-------------- init glad ----------------*/
     /* load opengl extensions */
@@ -99,12 +159,80 @@ GLFWwindow* windowCreate(const std::string& title, unsigned int width = 1280, un
         return nullptr;
     }
 
+    /* report driver errors asynchronously instead of polling glGetError */
+    if(!debugLogEnable())
+    {
+        std::cout << "[Window] GL_KHR_debug not available, errors are only reported by glCheckError() in debug builds" << std::endl;
+    }
+
+    /* the pixels of a hidden window are undefined, render into our own framebuffer */
+    if(headless.enabled)
+    {
+        if(!detail::createOffscreenTarget(headless, width, height))
+        {
+            std::cerr << "Couldn't create offscreen framebuffer" << std::endl;
+            windowDelete(window);
+            return nullptr;
+        }
+        std::cout << "[Window] Headless " << width << "x" << height << ", " << headless.frameLimit << " frames on "
+                  << glGetString(GL_RENDERER) << std::endl;
+        headless.startTime = glfwGetTime();
+    }
+
     return window;
 }
 
 
+void windowSwapBuffers(GLFWwindow* window)
+{
+    /* the finished frame is still in the back buffer */
+    screenshotFrameEnd();
+    recordingFrameEnd();
+
+    detail::HeadlessTarget& headless = detail::headless();
+    if(!headless.enabled)
+    {
+        glfwSwapBuffers(window);
+        return;
+    }
+
+    headless.frames++;
+    if(headless.frameLimit > 0 && headless.frames >= headless.frameLimit)
+    {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
+    }
+}
+
+bool windowHeadless()
+{
+    return detail::headless().enabled;
+}
+
+GLuint windowFramebuffer()
+{
+    return detail::headless().fbo;
+}
+
 void windowDelete(GLFWwindow *window)
 {
+    recordingStop();
+    screenshotShutdown();
+
+    detail::HeadlessTarget& headless = detail::headless();
+    if(headless.fbo)
+    {
+        /* wait for the last frame so the timing covers all rendering */
+        glFinish();
+        double seconds = glfwGetTime() - headless.startTime;
+        std::cout << "[Window] Headless: " << headless.frames << " frames in " << seconds << " s ("
+                  << headless.frames / seconds << " fps)" << std::endl;
+
+        glDeleteFramebuffers(1, &headless.fbo);
+        glDeleteRenderbuffers(2, headless.renderbuffers);
+        headless = detail::HeadlessTarget();
+    }
+
+    debugLogShutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -21,6 +21,10 @@
 /**
  * @brief Create and initialize GLFW window and OpenGL context.
  *
+ * Headless mode (environment variable HEADLESS=1, always on in BUILD_HEADLESS builds) creates a hidden window without
+ * vsync and renders into an offscreen framebuffer instead. HEADLESS_SIZE=<width>x<height> overrides the resolution,
+ * HEADLESS_FRAMES=<n> the number of frames until the window asks to be closed (default 300, 0 runs until killed).
+ *
  * @param title Window title
  * @param width Window width
  * @param height Window height
@@ -28,25 +32,48 @@
  * @return Initialized GLFW window.
  */
 GLFWwindow* windowCreate(const std::string &title, unsigned int width, unsigned int height);
+
 /**
- * @brief Delete GLFW window and OpenGL contexst. Has to be called for each window after it is not used anymore.
+ * @brief Presents a finished frame. In headless mode the frame stays in the offscreen framebuffer and the window is
+ * flagged for closing once the frame limit is reached.
  *
- * @param window GLFW window to delete.
+ * @param window GLFW window.
  */
-void windowDelete(GLFWwindow* window);
+void windowSwapBuffers(GLFWwindow* window);
+
+/**
+ * @brief Returns whether frames are rendered offscreen (see windowCreate).
+ *
+ * @return True in headless mode.
+ */
+bool windowHeadless();
 
 /**
- * @brief Save current viewport as PNG image.
+ * @brief Returns the framebuffer that presented frames are rendered into. Code rendering into its own framebuffers has
+ * to bind this one again instead of 0.
+ *
+ * @return Offscreen framebuffer in headless mode, otherwise 0 (default framebuffer of the window).
+ */
+GLuint windowFramebuffer();
+/**
+ * @brief Delete GLFW window and OpenGL contexst. Has to be called for each window after it is not used anymore.
  *
- * @param filepath Path to output image.
+ * @param window GLFW window to delete.
  */
-void screenshotToPNG(const std::string &filepath);
+void windowDelete(GLFWwindow* window);
 
 /**
  * @brief Debugging function that checks for OpenGL errors and prints them if there are any.
  *
+ * glGetError waits for the driver, so glCheckError() compiles to nothing in release builds (NDEBUG). Errors are still
+ * reported there through the asynchronous debug log (see debuglog.h).
+ *
  * @param file Source file in which the error happend.
  * @param line Line in which the error happend.
  */
 GLenum glCheckError_(const char *file, int line);
+#ifdef NDEBUG
+#define glCheckError() ((void)0)
+#else
 #define glCheckError() glCheckError_(__FILE__, __LINE__)
+#endif
@@ -0,0 +1,181 @@
+#include "debuglog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#define DEBUGLOG_CAPACITY 256u   // power of two
+#define DEBUGLOG_MESSAGE_LENGTH 256u
+#define DEBUGLOG_DRAIN_INTERVAL std::chrono::milliseconds(5)
+
+namespace detail
+{
+    /* bounded multi-producer queue (D. Vyukov), the callback may run on driver threads */
+    struct LogSlot
+    {
+        std::atomic<size_t> sequence;
+        char text[DEBUGLOG_MESSAGE_LENGTH];
+    };
+
+    struct DebugLog
+    {
+        LogSlot slots[DEBUGLOG_CAPACITY];
+        alignas(64) std::atomic<size_t> enqueue{0};
+        alignas(64) size_t dequeue = 0;
+
+        std::atomic<unsigned long long> received{0};
+        std::atomic<unsigned long long> dropped{0};
+
+        std::thread drain;
+        std::atomic<bool> running{false};
+        bool callback = false;
+
+        DebugLog()
+        {
+            for(size_t i = 0; i < DEBUGLOG_CAPACITY; i++)
+            {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    /* never destroyed, the driver may still call back during static destruction */
+    DebugLog& debugLog()
+    {
+        static DebugLog* log = new DebugLog();
+        return *log;
+    }
+
+    /* never blocks, a full queue drops the message */
+    bool push(const char* prefix, const char* message, size_t length)
+    {
+        DebugLog& log = debugLog();
+        log.received.fetch_add(1, std::memory_order_relaxed);
+
+        size_t position = log.enqueue.load(std::memory_order_relaxed);
+        LogSlot* slot;
+        while(true)
+        {
+            slot = &log.slots[position & (DEBUGLOG_CAPACITY - 1)];
+            intptr_t difference = intptr_t(slot->sequence.load(std::memory_order_acquire)) - intptr_t(position);
+            if(difference == 0)
+            {
+                if(log.enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(difference < 0)
+            {
+                log.dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = log.enqueue.load(std::memory_order_relaxed);
+            }
+        }
+
+        size_t prefixLength = std::min<size_t>(std::strlen(prefix), DEBUGLOG_MESSAGE_LENGTH - 1);
+        size_t textLength = std::min<size_t>(length, DEBUGLOG_MESSAGE_LENGTH - 1 - prefixLength);
+        std::memcpy(slot->text, prefix, prefixLength);
+        std::memcpy(slot->text + prefixLength, message, textLength);
+        slot->text[prefixLength + textLength] = '\0';
+
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* only called by the drain thread, or after it was joined */
+    void drain()
+    {
+        DebugLog& log = debugLog();
+        while(true)
+        {
+            LogSlot& slot = log.slots[log.dequeue & (DEBUGLOG_CAPACITY - 1)];
+            if(slot.sequence.load(std::memory_order_acquire) != log.dequeue + 1)
+            {
+                break;
+            }
+
+            std::cerr << slot.text << std::endl;
+            slot.sequence.store(log.dequeue + DEBUGLOG_CAPACITY, std::memory_order_release);
+            log.dequeue++;
+        }
+    }
+
+    const char* severityName(GLenum severity)
+    {
+        switch(severity)
+        {
+            case GL_DEBUG_SEVERITY_HIGH:    return "[GL high] ";
+            case GL_DEBUG_SEVERITY_MEDIUM:  return "[GL medium] ";
+            case GL_DEBUG_SEVERITY_LOW:     return "[GL low] ";
+            default:                        return "[GL] ";
+        }
+    }
+
+    void APIENTRY debugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+    {
+        push(severityName(severity), message, length >= 0 ? size_t(length) : std::strlen(message));
+    }
+}
+
+bool debugLogEnable()
+{
+    detail::DebugLog& log = detail::debugLog();
+    if(!GLAD_GL_KHR_debug || log.callback)
+    {
+        return log.callback;
+    }
+
+    /* asynchronous output, GL_DEBUG_OUTPUT_SYNCHRONOUS would stall the driver like glGetError does */
+    glEnable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback(detail::debugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+    log.callback = true;
+
+    log.running = true;
+    log.drain = std::thread([&log]()
+    {
+        while(log.running.load(std::memory_order_relaxed))
+        {
+            detail::drain();
+            std::this_thread::sleep_for(DEBUGLOG_DRAIN_INTERVAL);
+        }
+    });
+    return true;
+}
+
+DebugLogStats debugLogStats()
+{
+    detail::DebugLog& log = detail::debugLog();
+
+    DebugLogStats stats;
+    stats.received = log.received.load(std::memory_order_relaxed);
+    stats.dropped = log.dropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void debugLogShutdown()
+{
+    detail::DebugLog& log = detail::debugLog();
+    if(log.callback)
+    {
+        glDisable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(nullptr, nullptr);
+        log.callback = false;
+    }
+
+    if(log.drain.joinable())
+    {
+        log.running = false;
+        log.drain.join();
+    }
+    detail::drain();
+    std::cerr.flush();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "base.h"
+
+/* messages seen by the debug log since it was enabled */
+struct DebugLogStats
+{
+    unsigned long long received = 0;
+    unsigned long long dropped = 0;  // queue was full, the driver produced messages faster than they were printed
+};
+
+/**
+ * @brief Routes OpenGL debug output (GL_KHR_debug) into a lock-free queue that a background thread prints to
+ * std::cerr. The driver reports errors asynchronously, so no glGetError round trip is needed in the frame loop.
+ * Notifications are filtered out. Called by windowCreate(...), does nothing without GL_KHR_debug.
+ *
+ * @return Whether debug output is active.
+ */
+bool debugLogEnable();
+
+/**
+ * @brief Returns the message counters.
+ *
+ * @return Received and dropped messages.
+ */
+DebugLogStats debugLogStats();
+
+/**
+ * @brief Detaches the callback, stops the background thread and prints all queued messages. Has to be called while the
+ * context is still current, done by windowDelete(...).
+ */
+void debugLogShutdown();
@@ -0,0 +1,170 @@
+#include "framepacer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#define FRAME_PACER_SPIN_SECONDS 0.002   // sleep overshoots by up to a scheduler tick, spin for the rest
+
+namespace detail
+{
+    double pacerNow()
+    {
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void frameFinished(FramePacer& pacer, unsigned int slot, double now)
+    {
+        double latency = (now - pacer.inputTime[slot]) * 1000.0;
+        pacer.stats.latencyMs += latency;
+        pacer.stats.maxLatencyMs = std::max(pacer.stats.maxLatencyMs, latency);
+        pacer.stats.frames++;
+
+        glDeleteSync(pacer.fences[slot]);
+        pacer.fences[slot] = nullptr;
+    }
+
+    /* records frames the GPU finished since the last check, without waiting */
+    void pollFences(FramePacer& pacer)
+    {
+        for(unsigned int i = 0; i < pacer.maxFramesInFlight; i++)
+        {
+            unsigned int slot = (pacer.next + i) % pacer.maxFramesInFlight;
+            if(!pacer.fences[slot])
+            {
+                continue;
+            }
+            if(glClientWaitSync(pacer.fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                break;
+            }
+            frameFinished(pacer, slot, pacerNow());
+        }
+    }
+
+    void sleepUntil(double deadline)
+    {
+        double remaining = deadline - pacerNow();
+        if(remaining > FRAME_PACER_SPIN_SECONDS)
+        {
+            std::this_thread::sleep_for(std::chrono::duration<double>(remaining - FRAME_PACER_SPIN_SECONDS));
+        }
+        while(pacerNow() < deadline)
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+FramePacer framePacerCreate(int swapInterval, double targetFps, unsigned int maxFramesInFlight)
+{
+    if(maxFramesInFlight < 1 || maxFramesInFlight > FRAME_PACER_MAX_IN_FLIGHT || targetFps < 0.0)
+    {
+        std::cerr << "[FramePacer] Invalid settings: " << maxFramesInFlight << " frames in flight (1 to "
+                  << FRAME_PACER_MAX_IN_FLIGHT << "), limit " << targetFps << " fps" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[FramePacer] Invalid settings");
+    }
+
+    if(swapInterval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+       !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+    {
+        std::cout << "[FramePacer] Adaptive vsync is not supported, using vsync" << std::endl;
+        swapInterval = 1;
+    }
+
+    FramePacer pacer;
+    pacer.swapInterval = swapInterval;
+    pacer.targetFps = targetFps;
+    pacer.maxFramesInFlight = maxFramesInFlight;
+
+    /* headless frames are never presented, there is nothing to synchronize with */
+    glfwSwapInterval(windowHeadless() ? 0 : swapInterval);
+    return pacer;
+}
+
+void framePacerDelete(FramePacer& pacer)
+{
+    for(GLsync fence : pacer.fences)
+    {
+        if(fence)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    pacer = FramePacer();
+}
+
+void framePacerWait(FramePacer& pacer)
+{
+    detail::pollFences(pacer);
+
+    /* the slot of this frame still holds the frame maxFramesInFlight frames ago */
+    unsigned int slot = pacer.next;
+    if(pacer.fences[slot])
+    {
+        double start = detail::pacerNow();
+        glClientWaitSync(pacer.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        double now = detail::pacerNow();
+        pacer.stats.gpuWaitMs += (now - start) * 1000.0;
+        detail::frameFinished(pacer, slot, now);
+    }
+
+    if(pacer.targetFps > 0.0)
+    {
+        double period = 1.0 / pacer.targetFps;
+        double start = detail::pacerNow();
+
+        /* after a hitch start a new schedule instead of rushing frames to catch up */
+        if(pacer.deadline < start - period)
+        {
+            pacer.deadline = start;
+        }
+        detail::sleepUntil(pacer.deadline);
+        pacer.deadline += period;
+        pacer.stats.limiterMs += (detail::pacerNow() - start) * 1000.0;
+    }
+
+    pacer.frameInput = detail::pacerNow();
+}
+
+void framePacerFrameEnd(FramePacer& pacer)
+{
+    unsigned int slot = pacer.next;
+    pacer.fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pacer.inputTime[slot] = pacer.frameInput;
+    pacer.next = (pacer.next + 1) % pacer.maxFramesInFlight;
+
+    /* make sure the fence reaches the GPU, a later wait on it would otherwise have to flush first */
+    glFlush();
+
+    /* swapping may have waited long enough for older frames to finish */
+    detail::pollFences(pacer);
+}
+
+void framePacerDrain(FramePacer& pacer)
+{
+    for(unsigned int i = 0; i < pacer.maxFramesInFlight; i++)
+    {
+        unsigned int slot = (pacer.next + i) % pacer.maxFramesInFlight;
+        if(pacer.fences[slot])
+        {
+            glClientWaitSync(pacer.fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            detail::frameFinished(pacer, slot, detail::pacerNow());
+        }
+    }
+}
+
+FramePacerStats framePacerStats(FramePacer& pacer)
+{
+    FramePacerStats stats = pacer.stats;
+    if(stats.frames > 0)
+    {
+        stats.latencyMs /= stats.frames;
+    }
+    pacer.stats = FramePacerStats();
+    return stats;
+}
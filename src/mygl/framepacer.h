@@ -0,0 +1,97 @@
+#pragma once
+
+#include "base.h"
+
+#define FRAME_PACER_MAX_IN_FLIGHT 4u
+
+/* measurements since the last framePacerStats(...) call */
+struct FramePacerStats
+{
+    unsigned int frames = 0;
+    double latencyMs = 0.0;      // average time from polling input until the GPU finished the frame
+    double maxLatencyMs = 0.0;
+    double gpuWaitMs = 0.0;      // total time blocked by the frames in flight cap
+    double limiterMs = 0.0;      // total time slept and spun by the frame limiter
+};
+
+struct FramePacer
+{
+    /* settings */
+    int swapInterval = 1;                // 0 uncapped, 1 every vertical blank, -1 adaptive (late frames tear)
+    double targetFps = 0.0;              // frame limiter, 0 disables it
+    unsigned int maxFramesInFlight = 2;  // frames submitted to the GPU but not finished yet
+
+    /* one fence per frame in flight, together with the time its input was polled */
+    GLsync fences[FRAME_PACER_MAX_IN_FLIGHT] = {};
+    double inputTime[FRAME_PACER_MAX_IN_FLIGHT] = {};
+    unsigned int next = 0;
+
+    double deadline = 0.0;   // earliest start of the next frame when the limiter is on
+    double frameInput = 0.0; // input time of the frame being built
+
+    FramePacerStats stats;
+};
+
+/**
+ * @brief Sets up frame pacing. The swap interval trades tearing against waiting for the vertical blank, the limiter
+ * caps the frame rate by sleeping and spinning for the last stretch, and the frames in flight cap bounds how far the CPU
+ * may run ahead of the GPU. Fewer frames in flight lower the latency from input to display, more keep the GPU busy.
+ *
+ * @param swapInterval 0 for uncapped (benchmarks), 1 for vsync, -1 for adaptive vsync if supported (falls back to 1).
+ * @param targetFps Frame rate limit, 0 for none.
+ * @param maxFramesInFlight Frames the GPU may lag behind, between 1 and FRAME_PACER_MAX_IN_FLIGHT.
+ *
+ * @return Frame pacer.
+ *
+ * usage:
+ *
+ *   FramePacer pacer = framePacerCreate(1, 0.0, 2);
+ *   while(...)
+ *   {
+ *       framePacerWait(pacer);
+ *       glfwPollEvents();
+ *       ... update and draw
+ *       windowSwapBuffers(window);
+ *       framePacerFrameEnd(pacer);
+ *   }
+ */
+FramePacer framePacerCreate(int swapInterval, double targetFps, unsigned int maxFramesInFlight);
+
+/**
+ * @brief Releases the fences of all frames still in flight.
+ *
+ * @param pacer Frame pacer.
+ */
+void framePacerDelete(FramePacer& pacer);
+
+/**
+ * @brief Blocks until the next frame may start: waits until the GPU is at most maxFramesInFlight - 1 frames behind,
+ * then for the frame limiter. Call right before polling input so the frame works with the latest input.
+ *
+ * @param pacer Frame pacer.
+ */
+void framePacerWait(FramePacer& pacer);
+
+/**
+ * @brief Fences the frame that was just submitted. Call after swapping buffers.
+ *
+ * @param pacer Frame pacer.
+ */
+void framePacerFrameEnd(FramePacer& pacer);
+
+/**
+ * @brief Waits for all frames in flight, e.g. before the main loop goes to sleep, so their latency is measured when
+ * they finish rather than when the loop wakes up again.
+ *
+ * @param pacer Frame pacer.
+ */
+void framePacerDrain(FramePacer& pacer);
+
+/**
+ * @brief Returns the measurements since the last call and starts new ones.
+ *
+ * @param pacer Frame pacer.
+ *
+ * @return Latency and waiting times.
+ */
+FramePacerStats framePacerStats(FramePacer& pacer);
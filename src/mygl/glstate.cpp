@@ -0,0 +1,250 @@
+#include "glstate.h"
+
+#define GLSTATE_UNKNOWN 0xFFFFFFFFu
+#define GLSTATE_INDEXED_BINDINGS 16u
+
+namespace detail
+{
+    enum eBufferSlot { ArrayBuffer, ElementArrayBuffer, CopyReadBuffer, CopyWriteBuffer, DrawIndirectBuffer, UniformBuffer,
+                       ShaderStorageBuffer, PixelPackBuffer, PixelUnpackBuffer, BufferSlotCount };
+
+    struct IndexedBinding
+    {
+        GLuint buffer = GLSTATE_UNKNOWN;
+        GLintptr offset = 0;
+        GLsizeiptr size = 0;
+    };
+
+    struct GLStateCache
+    {
+        GLuint program = GLSTATE_UNKNOWN;
+        GLuint vao = GLSTATE_UNKNOWN;
+        GLuint buffers[BufferSlotCount];
+        IndexedBinding uniformBindings[GLSTATE_INDEXED_BINDINGS];
+        IndexedBinding storageBindings[GLSTATE_INDEXED_BINDINGS];
+
+        GLuint depthTest = GLSTATE_UNKNOWN;
+        GLuint blend = GLSTATE_UNKNOWN;
+        GLuint cullFace = GLSTATE_UNKNOWN;
+        GLuint depthFunc = GLSTATE_UNKNOWN;
+        GLuint depthMask = GLSTATE_UNKNOWN;
+        GLuint blendSource = GLSTATE_UNKNOWN;
+        GLuint blendDestination = GLSTATE_UNKNOWN;
+        GLuint cullMode = GLSTATE_UNKNOWN;
+
+        GLStateCounters frame;
+        GLStateCounters lastFrame;
+
+        GLStateCache()
+        {
+            for(GLuint& buffer : buffers)
+            {
+                buffer = GLSTATE_UNKNOWN;
+            }
+        }
+    };
+
+    GLStateCache& glState()
+    {
+        static GLStateCache state;
+        return state;
+    }
+
+    int bufferSlot(GLenum target)
+    {
+        switch(target)
+        {
+            case GL_ARRAY_BUFFER:           return ArrayBuffer;
+            case GL_ELEMENT_ARRAY_BUFFER:   return ElementArrayBuffer;
+            case GL_COPY_READ_BUFFER:       return CopyReadBuffer;
+            case GL_COPY_WRITE_BUFFER:      return CopyWriteBuffer;
+            case GL_DRAW_INDIRECT_BUFFER:   return DrawIndirectBuffer;
+            case GL_UNIFORM_BUFFER:         return UniformBuffer;
+            case GL_SHADER_STORAGE_BUFFER:  return ShaderStorageBuffer;
+            case GL_PIXEL_PACK_BUFFER:      return PixelPackBuffer;
+            case GL_PIXEL_UNPACK_BUFFER:    return PixelUnpackBuffer;
+            default:                        return -1;
+        }
+    }
+
+    /* compares a cached value, counts the call and updates the cache if it has to be issued */
+    bool changes(GLuint& cached, GLuint value)
+    {
+        GLStateCache& state = glState();
+        if(cached == value)
+        {
+            state.frame.skipped++;
+            return false;
+        }
+        cached = value;
+        state.frame.issued++;
+        return true;
+    }
+}
+
+void glStateUseProgram(GLuint program)
+{
+    if(detail::changes(detail::glState().program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+void glStateBindVertexArray(GLuint vao)
+{
+    detail::GLStateCache& state = detail::glState();
+    if(detail::changes(state.vao, vao))
+    {
+        glBindVertexArray(vao);
+        state.buffers[detail::ElementArrayBuffer] = GLSTATE_UNKNOWN;
+    }
+}
+
+void glStateBindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = detail::bufferSlot(target);
+    if(slot < 0)
+    {
+        detail::glState().frame.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+
+    if(detail::changes(detail::glState().buffers[slot], buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void glStateBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    detail::GLStateCache& state = detail::glState();
+    detail::IndexedBinding* bindings = (target == GL_UNIFORM_BUFFER) ? state.uniformBindings
+                                     : (target == GL_SHADER_STORAGE_BUFFER) ? state.storageBindings : nullptr;
+    if(!bindings || index >= GLSTATE_INDEXED_BINDINGS)
+    {
+        state.frame.issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+    }
+
+    detail::IndexedBinding& binding = bindings[index];
+    if(binding.buffer == buffer && binding.offset == offset && binding.size == size)
+    {
+        state.frame.skipped++;
+        return;
+    }
+
+    glBindBufferRange(target, index, buffer, offset, size);
+    binding = {buffer, offset, size};
+    state.buffers[detail::bufferSlot(target)] = buffer;
+    state.frame.issued++;
+}
+
+void glStateEnable(GLenum cap, bool enabled)
+{
+    detail::GLStateCache& state = detail::glState();
+    GLuint* cached = (cap == GL_DEPTH_TEST) ? &state.depthTest
+                   : (cap == GL_BLEND) ? &state.blend
+                   : (cap == GL_CULL_FACE) ? &state.cullFace : nullptr;
+
+    GLuint untracked = GLSTATE_UNKNOWN;
+    if(detail::changes(cached ? *cached : untracked, enabled ? 1 : 0))
+    {
+        enabled ? glEnable(cap) : glDisable(cap);
+    }
+}
+
+void glStateDepthFunc(GLenum func)
+{
+    if(detail::changes(detail::glState().depthFunc, func))
+    {
+        glDepthFunc(func);
+    }
+}
+
+void glStateDepthMask(bool write)
+{
+    if(detail::changes(detail::glState().depthMask, write ? 1 : 0))
+    {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+}
+
+void glStateBlendFunc(GLenum source, GLenum destination)
+{
+    detail::GLStateCache& state = detail::glState();
+    if(state.blendSource == source && state.blendDestination == destination)
+    {
+        state.frame.skipped++;
+        return;
+    }
+
+    glBlendFunc(source, destination);
+    state.blendSource = source;
+    state.blendDestination = destination;
+    state.frame.issued++;
+}
+
+void glStateCullFace(GLenum mode)
+{
+    if(detail::changes(detail::glState().cullMode, mode))
+    {
+        glCullFace(mode);
+    }
+}
+
+void glStateForget(const GLuint* buffers, unsigned int bufferCount, const GLuint* vaos, unsigned int vaoCount)
+{
+    detail::GLStateCache& state = detail::glState();
+    for(unsigned int i = 0; i < bufferCount; i++)
+    {
+        for(GLuint& buffer : state.buffers)
+        {
+            buffer = (buffer == buffers[i]) ? 0 : buffer;
+        }
+        for(unsigned int k = 0; k < GLSTATE_INDEXED_BINDINGS; k++)
+        {
+            if(state.uniformBindings[k].buffer == buffers[i])
+            {
+                state.uniformBindings[k] = detail::IndexedBinding();
+            }
+            if(state.storageBindings[k].buffer == buffers[i])
+            {
+                state.storageBindings[k] = detail::IndexedBinding();
+            }
+        }
+    }
+    for(unsigned int i = 0; i < vaoCount; i++)
+    {
+        if(state.vao == vaos[i])
+        {
+            state.vao = 0;
+            state.buffers[detail::ElementArrayBuffer] = GLSTATE_UNKNOWN;
+        }
+    }
+}
+
+void glStateInvalidate()
+{
+    detail::GLStateCache& state = detail::glState();
+    GLStateCounters frame = state.frame;
+    GLStateCounters lastFrame = state.lastFrame;
+
+    state = detail::GLStateCache();
+    state.frame = frame;
+    state.lastFrame = lastFrame;
+}
+
+GLStateCounters glStateFrameEnd()
+{
+    detail::GLStateCache& state = detail::glState();
+    state.lastFrame = state.frame;
+    state.frame = GLStateCounters();
+    return state.lastFrame;
+}
+
+GLStateCounters glStateLastFrame()
+{
+    return detail::glState().lastFrame;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "base.h"
+
+/* driver calls of one frame that changed state or were dropped because the state was already set */
+struct GLStateCounters
+{
+    unsigned int issued = 0;
+    unsigned int skipped = 0;
+};
+
+/**
+ * @brief Binds a shader program unless it is already in use.
+ *
+ * @param program Program name (0 to unbind).
+ */
+void glStateUseProgram(GLuint program);
+
+/**
+ * @brief Binds a vertex array object unless it is already bound. The element array binding is part of the VAO, so it
+ * becomes unknown when the VAO changes.
+ *
+ * @param vao Vertex array name (0 to unbind).
+ */
+void glStateBindVertexArray(GLuint vao);
+
+/**
+ * @brief Binds a buffer to a target unless it is already bound there. Untracked targets are passed through.
+ *
+ * @param target Buffer target (GL_ARRAY_BUFFER, GL_COPY_WRITE_BUFFER, ...).
+ * @param buffer Buffer name (0 to unbind).
+ */
+void glStateBindBuffer(GLenum target, GLuint buffer);
+
+/**
+ * @brief Binds a range of a buffer to an indexed binding point unless exactly this range is already bound. Like
+ * glBindBufferRange this also binds the buffer to the generic target.
+ *
+ * @param target Indexed target (GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER).
+ * @param index Binding point.
+ * @param buffer Buffer name.
+ * @param offset Start of the range in bytes.
+ * @param size Size of the range in bytes.
+ */
+void glStateBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+/**
+ * @brief Enables or disables a capability unless it is already in that state. Tracks GL_DEPTH_TEST, GL_BLEND and
+ * GL_CULL_FACE, other capabilities are passed through.
+ *
+ * @param cap Capability.
+ * @param enabled Whether it should be enabled.
+ */
+void glStateEnable(GLenum cap, bool enabled);
+
+/**
+ * @brief Sets the depth comparison unless it is already set.
+ *
+ * @param func Depth function (see glDepthFunc).
+ */
+void glStateDepthFunc(GLenum func);
+
+/**
+ * @brief Enables or disables depth writes unless they are already in that state.
+ *
+ * @param write Whether depth is written.
+ */
+void glStateDepthMask(bool write);
+
+/**
+ * @brief Sets the blend factors unless they are already set.
+ *
+ * @param source Source factor (see glBlendFunc).
+ * @param destination Destination factor.
+ */
+void glStateBlendFunc(GLenum source, GLenum destination);
+
+/**
+ * @brief Sets the culled faces unless they are already set.
+ *
+ * @param mode GL_FRONT, GL_BACK or GL_FRONT_AND_BACK.
+ */
+void glStateCullFace(GLenum mode);
+
+/**
+ * @brief Drops cached bindings of a deleted buffer or vertex array, OpenGL unbinds them implicitly and the name may be
+ * reused by a new object. Called by the resource manager.
+ *
+ * @param buffers Deleted buffer names.
+ * @param bufferCount Number of buffer names.
+ * @param vaos Deleted vertex array names.
+ * @param vaoCount Number of vertex array names.
+ */
+void glStateForget(const GLuint* buffers, unsigned int bufferCount, const GLuint* vaos, unsigned int vaoCount);
+
+/**
+ * @brief Marks the whole cached state as unknown. Has to be called after code that changes state without going through
+ * the cache (e.g. third party renderers).
+ */
+void glStateInvalidate();
+
+/**
+ * @brief Finishes the counters of the current frame. Has to be called once per frame.
+ *
+ * @return Counters of the frame that just ended.
+ */
+GLStateCounters glStateFrameEnd();
+
+/**
+ * @brief Returns the counters of the last finished frame.
+ *
+ * @return Issued and skipped calls.
+ */
+GLStateCounters glStateLastFrame();
@@ -0,0 +1,205 @@
+#include "gpucull.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace detail
+{
+    /* compute shaders, storage buffers and indirect draws are core in 4.3, glad loads them through the extensions */
+    bool computeCullSupported()
+    {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        bool version = major > 4 || (major == 4 && minor >= 3);
+        return version && GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object &&
+               GLAD_GL_ARB_draw_indirect && GLAD_GL_ARB_shader_image_load_store;
+    }
+
+    /* planes of the view frustum (Gribb/Hartmann), normals point inwards and are normalized */
+    void frustumPlanes(const Camera& camera, Vector4D planes[6])
+    {
+        Matrix4D viewProj = cameraProjection(camera) * cameraView(camera);
+        Vector4D row[4];
+        for(int i = 0; i < 4; i++)
+        {
+            row[i] = Vector4D(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+        }
+
+        planes[0] = row[3] + row[0];
+        planes[1] = row[3] - row[0];
+        planes[2] = row[3] + row[1];
+        planes[3] = row[3] - row[1];
+        planes[4] = row[3] + row[2];
+        planes[5] = row[3] - row[2];
+        for(int i = 0; i < 6; i++)
+        {
+            planes[i] = planes[i] * (1.0f / length(Vector3D(planes[i])));
+        }
+    }
+
+    void setCullModelAttribPointer(GLsizeiptr offset)
+    {
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(eInstanceDataIdx::Model + column, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4D),
+                                  (void*) (offset + column * sizeof(Vector4D)));
+        }
+    }
+
+    DrawElementsIndirectCommand meshCommand(const Mesh& mesh, GLuint instanceCount)
+    {
+        return {mesh.size_ibo, instanceCount, mesh.firstIndex, mesh.baseVertex, 0};
+    }
+}
+
+GpuCull gpuCullCreate(const Mesh& mesh, const std::vector<Matrix4D>& models, bool forceCpu)
+{
+    GpuCull cull;
+    cull.mesh = &mesh;
+
+    /* bounding spheres are moved to world space once, the instances don't move */
+    cull.instances.reserve(models.size());
+    for(const Matrix4D& model : models)
+    {
+        float scale = std::max({length(Vector3D(model[0])), length(Vector3D(model[1])), length(Vector3D(model[2]))});
+        Vector3D center = Vector3D(model * Vector4D(mesh.boundsCenter, 1.0f));
+        cull.instances.push_back({model, Vector4D(center, mesh.boundsRadius * scale)});
+    }
+
+    cull.compute = !forceCpu && !models.empty() && detail::computeCullSupported();
+    if(cull.compute)
+    {
+        try
+        {
+            cull.program = shaderCreateCompute(shaderSource("cull.comp"));
+        }
+        catch(const std::runtime_error&)
+        {
+            /* e.g. a driver that advertises the extensions but rejects the shader */
+            std::cerr << "[GpuCull] Compute shader unavailable, culling on the CPU" << std::endl;
+            cull.compute = false;
+        }
+    }
+
+    if(cull.compute)
+    {
+        cull.planesUniform = shaderUniformHandle(cull.program, "uPlanes");
+        cull.countUniform = shaderUniformHandle(cull.program, "uCount");
+
+        cull.instanceBuffer = bufferCreate();
+        bufferData(cull.instanceBuffer, GL_SHADER_STORAGE_BUFFER, cull.instances.size() * sizeof(CullInstance),
+                   cull.instances.data(), GL_STATIC_DRAW);
+        cull.visibleBuffer = bufferCreate();
+        bufferData(cull.visibleBuffer, GL_SHADER_STORAGE_BUFFER, cull.instances.size() * sizeof(Matrix4D), nullptr,
+                   GL_DYNAMIC_COPY);
+        DrawElementsIndirectCommand command = detail::meshCommand(mesh, 0);
+        cull.commandBuffer = bufferCreate();
+        bufferData(cull.commandBuffer, GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+        glCheckError();
+    }
+    else
+    {
+        /* the survivors can be any number up to all instances, more than fits the shared stream ring in one frame */
+        cull.visible.reserve(cull.instances.size());
+        cull.visibleBuffer = bufferCreate();
+        bufferData(cull.visibleBuffer, GL_ARRAY_BUFFER, cull.instances.size() * sizeof(Matrix4D), nullptr,
+                   GL_STREAM_DRAW);
+        glCheckError();
+    }
+
+    std::cout << "[GpuCull] " << cull.instances.size() << " instances culled on the " << (cull.compute ? "GPU" : "CPU")
+              << std::endl;
+    return cull;
+}
+
+void gpuCullDelete(GpuCull& cull)
+{
+    shaderDelete(cull.program);
+    cull = GpuCull();
+}
+
+void gpuCullDispatch(GpuCull& cull, const Camera& camera)
+{
+    if(cull.instances.empty())
+    {
+        return;
+    }
+
+    Vector4D planes[6];
+    detail::frustumPlanes(camera, planes);
+
+    if(!cull.compute)
+    {
+        cull.visible.clear();
+        for(const CullInstance& instance : cull.instances)
+        {
+            bool inside = true;
+            for(int i = 0; i < 6 && inside; i++)
+            {
+                inside = dot(Vector3D(planes[i]), Vector3D(instance.sphere)) + planes[i].w >= -instance.sphere.w;
+            }
+            if(inside)
+            {
+                cull.visible.push_back(instance.model);
+            }
+        }
+        cull.lastFrameVisible = static_cast<unsigned int>(cull.visible.size());
+        return;
+    }
+
+    /* only the instance count changes, the driver orders the write after last frame's draw */
+    DrawElementsIndirectCommand command = detail::meshCommand(*cull.mesh, 0);
+    glStateBindBuffer(GL_DRAW_INDIRECT_BUFFER, cull.commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+
+    GLsizeiptr count = cull.instances.size();
+    glStateBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, cull.instanceBuffer, 0, count * sizeof(CullInstance));
+    glStateBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, cull.visibleBuffer, 0, count * sizeof(Matrix4D));
+    glStateBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, cull.commandBuffer, 0, sizeof(command));
+
+    glStateUseProgram(cull.program.id);
+    glUniform4fv(cull.planesUniform.location, 6, &planes[0].x);
+    shaderUniform(cull.countUniform, static_cast<int>(count));
+    glDispatchCompute((count + GPU_CULL_GROUP_SIZE - 1) / GPU_CULL_GROUP_SIZE, 1, 1);
+
+    /* the draw reads the command and the model matrices written above */
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void gpuCullDraw(GpuCull& cull, MegaBuffer& pool)
+{
+    if(cull.instances.empty())
+    {
+        return;
+    }
+
+    glStateBindVertexArray(pool.vao);
+    if(cull.compute)
+    {
+        glStateBindBuffer(GL_ARRAY_BUFFER, cull.visibleBuffer);
+        detail::setCullModelAttribPointer(0);
+
+        glStateBindBuffer(GL_DRAW_INDIRECT_BUFFER, cull.commandBuffer);
+        glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+        return;
+    }
+
+    if(cull.visible.empty())
+    {
+        return;
+    }
+
+    /* orphaning hands the previous frame's storage to the driver, so the upload doesn't wait for its draw */
+    glStateBindBuffer(GL_ARRAY_BUFFER, cull.visibleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, cull.instances.size() * sizeof(Matrix4D), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, cull.visible.size() * sizeof(Matrix4D), cull.visible.data());
+    detail::setCullModelAttribPointer(0);
+
+    const Mesh& mesh = *cull.mesh;
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.size_ibo, GL_UNSIGNED_INT,
+                                      (void*) (mesh.firstIndex * sizeof(unsigned int)),
+                                      static_cast<GLsizei>(cull.visible.size()), mesh.baseVertex);
+}
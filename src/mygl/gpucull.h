@@ -0,0 +1,89 @@
+#pragma once
+
+#include "base.h"
+#include "camera.h"
+#include "megabuffer.h"
+#include "mesh.h"
+#include "resource.h"
+#include "shader.h"
+
+#include <vector>
+
+#define GPU_CULL_GROUP_SIZE 64u
+
+/* input of the culling pass, matches the std430 layout of the Instances buffer in cull.comp */
+struct CullInstance
+{
+    Matrix4D model;
+    Vector4D sphere;   // world space bounding sphere, center and radius
+};
+static_assert(sizeof(CullInstance) == 80, "CullInstance has to match the std430 layout of the Instances buffer");
+
+/* many copies of one mega buffer mesh, culled against the view frustum every frame and drawn with one draw call */
+struct GpuCull
+{
+    const Mesh* mesh = nullptr;
+    bool compute = false;              // cull in a compute shader, otherwise on the CPU
+
+    std::vector<CullInstance> instances;
+
+    /* compute path: instances in, surviving model matrices and the indirect command out, nothing is read back */
+    BufferHandle instanceBuffer;
+    BufferHandle visibleBuffer;
+    BufferHandle commandBuffer;
+    ShaderProgram program;
+    UniformHandle planesUniform;
+    UniformHandle countUniform;
+
+    /* CPU path: surviving model matrices of this frame, uploaded to visibleBuffer */
+    std::vector<Matrix4D> visible;
+
+    unsigned int lastFrameVisible = 0; // only known on the CPU path
+};
+
+/**
+ * @brief Prepares frustum culling for instances of a mesh allocated from a mega buffer. With compute shaders and shader
+ * storage buffers (GL 4.3 or GL_ARB_compute_shader and GL_ARB_shader_storage_buffer_object) the instances are culled
+ * on the GPU: a compute shader tests their bounding spheres, appends the model matrices of the survivors to a buffer
+ * and counts them into a DrawElementsIndirectCommand that glDrawElementsIndirect consumes directly. Otherwise the same
+ * test runs on the CPU and the survivors are uploaded into one instanced draw.
+ *
+ * @param mesh Mesh allocated from a mega buffer, has to outlive the culling set.
+ * @param models Model matrix of each instance.
+ * @param forceCpu Cull on the CPU even if compute shaders are available.
+ *
+ * @return Culling set.
+ *
+ * usage:
+ *
+ *   GpuCull crates = gpuCullCreate(crateMesh, models);
+ *   gpuCullDispatch(crates, camera);
+ *   glUseProgram(instanced-program);
+ *   gpuCullDraw(crates, pool);
+ */
+GpuCull gpuCullCreate(const Mesh& mesh, const std::vector<Matrix4D>& models, bool forceCpu = false);
+
+/**
+ * @brief Releases the buffers and the compute program.
+ *
+ * @param cull Culling set.
+ */
+void gpuCullDelete(GpuCull& cull);
+
+/**
+ * @brief Culls all instances against the camera frustum, on the GPU or the CPU. Changes the bound program, so call it
+ * before binding the program of the draw.
+ *
+ * @param cull Culling set.
+ * @param camera Camera whose view and projection give the frustum.
+ */
+void gpuCullDispatch(GpuCull& cull, const Camera& camera);
+
+/**
+ * @brief Draws the instances that survived the last gpuCullDispatch(...). The shader program has to be bound by the
+ * caller and take the model matrix as per-instance attribute aModel.
+ *
+ * @param cull Culling set.
+ * @param pool Mega buffer the mesh was allocated from.
+ */
+void gpuCullDraw(GpuCull& cull, MegaBuffer& pool);
@@ -0,0 +1,231 @@
+#include "impostor.h"
+#include "glstate.h"
+#include "megabuffer.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#define IMPOSTOR_FADE_BAND 1.25f   // cross-fade from the threshold up to this multiple of it
+
+namespace detail
+{
+    /* inverse of the hemi-octahedral encoding in impostor.vert, u and v in [-1, 1] */
+    Vector3D hemiOctahedronDecode(float u, float v)
+    {
+        float x = (u + v) * 0.5f;
+        float z = (u - v) * 0.5f;
+        return normalize(Vector3D(x, 1.0f - std::fabs(x) - std::fabs(z), z));
+    }
+
+    void captureFrames(ImpostorAtlas& atlas, StreamBuffer& stream, void (*drawModel)(void* user), void* user)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        GLsizei size = atlas.frames * atlas.frameSize;
+        GLuint fbo, depth;
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas.texture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer());
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &depth);
+            std::cerr << "[Impostor] Incomplete atlas framebuffer" << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Impostor] Incomplete atlas framebuffer");
+        }
+
+        /* uncovered texels stay transparent, the impostor shader discards them */
+        glViewport(0, 0, size, size);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        float r = atlas.radius;
+        Matrix4D projection = Matrix4D::ortho(-r, -r, r, r, 0.5f * r, 3.5f * r);
+        for(unsigned int j = 0; j < atlas.frames; j++)
+        {
+            for(unsigned int i = 0; i < atlas.frames; i++)
+            {
+                float u = 2.0f * i / (atlas.frames - 1) - 1.0f;
+                float v = 2.0f * j / (atlas.frames - 1) - 1.0f;
+                Vector3D direction = hemiOctahedronDecode(u, v);
+
+                /* straight from above the world up axis is degenerate, the frame is rolled like an orbit camera's */
+                Vector3D up = direction.y > 0.999f ? Vector3D(0.0f, 0.0f, -1.0f) : Vector3D(0.0f, 1.0f, 0.0f);
+                Camera view = cameraCreate(atlas.frameSize, atlas.frameSize, 0.0f, 0.5f * r, 3.5f * r,
+                                           atlas.center + direction * (2.0f * r), atlas.center, up);
+
+                PerFrameBlock frame;
+                frame.view = cameraView(view);
+                frame.proj = projection;
+                frame.viewProj = projection * frame.view;
+                frame.cameraPosition = Vector4D(view.position, 1.0f);
+                frame.time = 0.0f;
+                uniformBlockUpload(stream, eUniformBlockBinding::PerFrame, &frame, sizeof(frame));
+
+                glViewport(i * atlas.frameSize, j * atlas.frameSize, atlas.frameSize, atlas.frameSize);
+                drawModel(user);
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer());
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteRenderbuffers(1, &depth);
+
+        /* distant impostors cover a few pixels, the coarsest level keeps frames 8 texels wide so they don't bleed */
+        glBindTexture(GL_TEXTURE_2D, atlas.texture);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+ImpostorAtlas impostorAtlasCreate(StreamBuffer& stream, const Vector3D& center, float radius, void (*drawModel)(void* user),
+                                  void* user, unsigned int frames, unsigned int frameSize)
+{
+    if(frames < 2 || frameSize < 8 || radius <= 0.0f)
+    {
+        std::cerr << "[Impostor] Invalid atlas of " << frames << "x" << frames << " frames of " << frameSize
+                  << " pixels for radius " << radius << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Impostor] Invalid atlas settings");
+    }
+
+    /* impostors are instanced, glad only loads the attribute divisor through the extension */
+    if(!GLAD_GL_ARB_instanced_arrays)
+    {
+        std::cerr << "[Impostor] GL_ARB_instanced_arrays is not supported" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Impostor] GL_ARB_instanced_arrays is not supported");
+    }
+
+    ImpostorAtlas atlas;
+    atlas.frames = frames;
+    atlas.frameSize = frameSize;
+    atlas.center = center;
+    atlas.radius = radius;
+
+    GLsizei size = frames * frameSize;
+    int maxLevel = std::max(0, static_cast<int>(std::log2(static_cast<float>(frameSize))) - 3);
+    glGenTextures(1, &atlas.texture);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    detail::captureFrames(atlas, stream, drawModel, user);
+
+    /* quad corners, expanded to a camera facing square around the bounding sphere in the vertex shader */
+    const float corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+    atlas.vao = vertexArrayCreate();
+    atlas.vbo = bufferCreate();
+    glStateBindVertexArray(atlas.vao);
+    {
+        bufferData(atlas.vbo, GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(eDataIdx::Position);
+        glVertexAttribPointer(eDataIdx::Position, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+
+        /* instance data lives in the stream buffer, its pointers are set when drawing */
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(eInstanceDataIdx::Model + column);
+            glVertexAttribDivisorARB(eInstanceDataIdx::Model + column, 1);
+        }
+        glEnableVertexAttribArray(eImpostorDataIdx::Fade);
+        glVertexAttribDivisorARB(eImpostorDataIdx::Fade, 1);
+        glCheckError();
+    }
+    glStateBindVertexArray(0);
+
+    atlas.program = shaderCreate(shaderSource("impostor.vert"), shaderSource("impostor.frag"));
+    glStateUseProgram(atlas.program.id);
+    shaderUniform(atlas.program, "uBounds", Vector4D(center, radius));
+    shaderUniform(atlas.program, "uFrames", static_cast<float>(frames));
+    shaderUniform(atlas.program, "uAtlas", 0);
+
+    std::cout << "[Impostor] Captured " << frames * frames << " views into a " << size << "x" << size << " atlas" << std::endl;
+    return atlas;
+}
+
+void impostorAtlasDelete(ImpostorAtlas& atlas)
+{
+    if(atlas.texture)
+    {
+        glDeleteTextures(1, &atlas.texture);
+    }
+    shaderDelete(atlas.program);
+    atlas = ImpostorAtlas();
+}
+
+float impostorFade(const ImpostorAtlas& atlas, const Matrix4D& model, const Camera& camera, float pixelThreshold)
+{
+    if(pixelThreshold <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    float scale = std::max({length(Vector3D(model[0])), length(Vector3D(model[1])), length(Vector3D(model[2]))});
+    Vector3D center = Vector3D(model * Vector4D(atlas.center, 1.0f));
+    float distance = std::max(length(center - camera.position), camera.nearPlane);
+
+    /* projected diameter of the bounding sphere */
+    float pixels = 2.0f * atlas.radius * scale * camera.height / (2.0f * std::tan(camera.fov * 0.5f) * distance);
+    float fade = (pixelThreshold * IMPOSTOR_FADE_BAND - pixels) / (pixelThreshold * (IMPOSTOR_FADE_BAND - 1.0f));
+    return std::min(std::max(fade, 0.0f), 1.0f);
+}
+
+void impostorSubmit(ImpostorAtlas& atlas, const Matrix4D& model, float fade)
+{
+    ImpostorInstance instance;
+    instance.model = model;
+    instance.fade = fade;
+    atlas.instances.push_back(instance);
+}
+
+void impostorDraw(ImpostorAtlas& atlas, StreamBuffer& stream)
+{
+    atlas.lastFrameInstances = static_cast<unsigned int>(atlas.instances.size());
+    if(atlas.instances.empty())
+    {
+        return;
+    }
+
+    GLsizeiptr bytes = atlas.instances.size() * sizeof(ImpostorInstance);
+    StreamAllocation data = streamBufferMap(stream, bytes, sizeof(Vector4D));
+    std::memcpy(data.data, atlas.instances.data(), bytes);
+    streamBufferUnmap(stream);
+
+    glStateBindVertexArray(atlas.vao);
+    glStateBindBuffer(GL_ARRAY_BUFFER, stream.id);
+    for(unsigned int column = 0; column < 4; column++)
+    {
+        size_t offset = data.offset + offsetof(ImpostorInstance, model) + column * sizeof(Vector4D);
+        glVertexAttribPointer(eInstanceDataIdx::Model + column, 4, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance), (void*) offset);
+    }
+    glVertexAttribPointer(eImpostorDataIdx::Fade, 1, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+                          (void*) (data.offset + offsetof(ImpostorInstance, fade)));
+
+    glStateUseProgram(atlas.program.id);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas.texture);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(atlas.instances.size()));
+
+    atlas.instances.clear();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "base.h"
+#include "camera.h"
+#include "resource.h"
+#include "shader.h"
+#include "streambuffer.h"
+
+#include <vector>
+
+/* vertex attribute location of the cross-fade factor (after the model matrix and the static batch part index) */
+enum eImpostorDataIdx { Fade = 7 };
+
+/* per-instance data of an impostor quad */
+struct ImpostorInstance
+{
+    Matrix4D model;
+    float fade;          // 0 only the mesh is visible, 1 only the impostor
+    float _padding[3];
+};
+
+/* views of one model from a hemi-octahedral set of directions, rendered once into a grid of frames */
+struct ImpostorAtlas
+{
+    GLuint texture = 0;
+    unsigned int frames = 0;      // views per axis
+    unsigned int frameSize = 0;   // pixels per view and axis
+
+    /* bounding sphere of the model in model space */
+    Vector3D center;
+    float radius = 0.0f;
+
+    /* one corner per vertex, instanced per impostor */
+    VertexArrayHandle vao;
+    BufferHandle vbo;
+    ShaderProgram program;
+
+    /* impostors recorded this frame */
+    std::vector<ImpostorInstance> instances;
+    unsigned int lastFrameInstances = 0;
+};
+
+/**
+ * @brief Renders a model from frames x frames directions of the upper hemisphere into an atlas. The directions follow
+ * a hemi-octahedral mapping, so neighbouring frames are neighbouring views and a view direction maps to a frame with a
+ * few operations in the vertex shader. Vehicles are never seen from below, which doubles the resolution compared to the
+ * full octahedron. Has to be called with depth testing enabled, restores the window framebuffer and the viewport.
+ *
+ * @param stream Stream buffer receiving the view of each frame (PerFrame uniform block).
+ * @param center Center of the model's bounding sphere in model space.
+ * @param radius Radius of the bounding sphere.
+ * @param drawModel Draws the model in model space, called once per frame with the PerFrame block bound.
+ * @param user Passed to drawModel.
+ * @param frames Views per axis.
+ * @param frameSize Pixels per view and axis.
+ *
+ * @return Impostor atlas.
+ *
+ * usage:
+ *
+ *   ImpostorAtlas atlas = impostorAtlasCreate(stream, center, radius, drawCar, nullptr);
+ *   float fade = impostorFade(atlas, model, camera, 48.0f);
+ *   if(fade < 1.0f) ... draw the mesh, dithered by fade
+ *   if(fade > 0.0f) impostorSubmit(atlas, model, fade);
+ *   impostorDraw(atlas, stream);
+ */
+ImpostorAtlas impostorAtlasCreate(StreamBuffer& stream, const Vector3D& center, float radius, void (*drawModel)(void* user),
+                                  void* user, unsigned int frames = 8, unsigned int frameSize = 128);
+
+/**
+ * @brief Releases the atlas texture, quad and program.
+ *
+ * @param atlas Impostor atlas.
+ */
+void impostorAtlasDelete(ImpostorAtlas& atlas);
+
+/**
+ * @brief Decides between mesh and impostor by the projected size of the bounding sphere. Below the threshold only the
+ * impostor is drawn, up to a quarter above it both are cross-faded with complementary dither patterns.
+ *
+ * @param atlas Impostor atlas.
+ * @param model Model matrix of the object.
+ * @param camera Camera the object is seen with.
+ * @param pixelThreshold Projected diameter in pixels below which the impostor replaces the mesh.
+ *
+ * @return 0 for the mesh only, 1 for the impostor only, in between for both.
+ */
+float impostorFade(const ImpostorAtlas& atlas, const Matrix4D& model, const Camera& camera, float pixelThreshold);
+
+/**
+ * @brief Records an impostor for this frame.
+ *
+ * @param atlas Impostor atlas.
+ * @param model Model matrix of the object.
+ * @param fade Cross-fade factor returned by impostorFade(...).
+ */
+void impostorSubmit(ImpostorAtlas& atlas, const Matrix4D& model, float fade);
+
+/**
+ * @brief Draws all impostors recorded this frame as camera facing quads in one instanced draw.
+ *
+ * @param atlas Impostor atlas.
+ * @param stream Stream buffer receiving the instance data.
+ */
+void impostorDraw(ImpostorAtlas& atlas, StreamBuffer& stream);
@@ -0,0 +1,191 @@
+#include "megabuffer.h"
+#include "glstate.h"
+#include "mesh.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+unsigned int freeListAlloc(FreeListAllocator& allocator, unsigned int size)
+{
+    for(auto it = allocator.freeBlocks.begin(); it != allocator.freeBlocks.end(); ++it)
+    {
+        if(it->second < size)
+        {
+            continue;
+        }
+
+        unsigned int offset = it->first;
+        unsigned int remaining = it->second - size;
+        if(remaining > 0)
+        {
+            /* reuse the map node for the rest of the block, so splitting doesn't allocate */
+            auto node = allocator.freeBlocks.extract(it);
+            node.key() = offset + size;
+            node.mapped() = remaining;
+            allocator.freeBlocks.insert(std::move(node));
+        }
+        else
+        {
+            allocator.freeBlocks.erase(it);
+        }
+        allocator.used += size;
+        return offset;
+    }
+
+    return ~0u;
+}
+
+void freeListFree(FreeListAllocator& allocator, unsigned int offset, unsigned int size)
+{
+    if(size == 0)
+    {
+        return;
+    }
+
+    auto it = allocator.freeBlocks.emplace(offset, size).first;
+    allocator.used -= size;
+
+    /* merge with following block */
+    auto next = std::next(it);
+    if(next != allocator.freeBlocks.end() && it->first + it->second == next->first)
+    {
+        it->second += next->second;
+        allocator.freeBlocks.erase(next);
+    }
+
+    /* merge with preceding block */
+    if(it != allocator.freeBlocks.begin())
+    {
+        auto prev = std::prev(it);
+        if(prev->first + prev->second == it->first)
+        {
+            prev->second += it->second;
+            allocator.freeBlocks.erase(it);
+        }
+    }
+}
+
+namespace detail
+{
+    void setModelAttribPointer(GLsizeiptr offset)
+    {
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(eInstanceDataIdx::Model + column, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4D),
+                                  (void*) (offset + column * sizeof(Vector4D)));
+        }
+    }
+}
+
+MegaBuffer megaBufferCreate(unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+    /* the per-instance model matrix needs attribute divisors, glad only loads them through the extension */
+    if(!GLAD_GL_ARB_instanced_arrays)
+    {
+        std::cerr << "[MegaBuffer] GL_ARB_instanced_arrays is not supported" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[MegaBuffer] GL_ARB_instanced_arrays is not supported");
+    }
+
+    MegaBuffer pool;
+    pool.vertexAllocator.capacity = vertexCapacity;
+    pool.vertexAllocator.freeBlocks[0] = vertexCapacity;
+    pool.indexAllocator.capacity = indexCapacity;
+    pool.indexAllocator.freeBlocks[0] = indexCapacity;
+
+    pool.vao = vertexArrayCreate();
+    pool.vbo = bufferCreate();
+    pool.ebo = bufferCreate();
+
+    glStateBindVertexArray(pool.vao);
+    {
+        bufferData(pool.vbo, GL_ARRAY_BUFFER, vertexCapacity * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        bufferData(pool.ebo, GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(eDataIdx::Position);
+        glEnableVertexAttribArray(eDataIdx::Color);
+        glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+        glVertexAttribPointer(eDataIdx::Color,      4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, color));
+
+        /* model matrix is a per-instance attribute selected by the base instance of each draw, its buffer is set on submit */
+        for(unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(eInstanceDataIdx::Model + column);
+            glVertexAttribDivisorARB(eInstanceDataIdx::Model + column, 1);
+        }
+        glCheckError();
+    }
+
+    glStateBindVertexArray(0);
+
+    return pool;
+}
+
+void megaBufferDelete(MegaBuffer& pool)
+{
+    pool = MegaBuffer();
+}
+
+void megaBufferDrawBegin(MegaBuffer& pool)
+{
+    pool.commands.clear();
+    pool.models.clear();
+}
+
+void megaBufferDrawAdd(MegaBuffer& pool, const Mesh& mesh, const Matrix4D& model, unsigned int lod)
+{
+    GLuint instance = pool.models.size();
+    if(lod < mesh.lods.size())
+    {
+        pool.commands.push_back({mesh.lods[lod].count, 1, mesh.lods[lod].firstIndex, mesh.baseVertex, instance});
+    }
+    else
+    {
+        pool.commands.push_back({mesh.size_ibo, 1, mesh.firstIndex, mesh.baseVertex, instance});
+    }
+    pool.models.push_back(model);
+}
+
+void megaBufferDrawSubmit(MegaBuffer& pool, StreamBuffer& stream)
+{
+    if(pool.commands.empty())
+    {
+        return;
+    }
+
+    bool indirect = GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_base_instance;
+
+    StreamAllocation models = streamBufferMap(stream, pool.models.size() * sizeof(Matrix4D), sizeof(Vector4D));
+    std::memcpy(models.data, pool.models.data(), pool.models.size() * sizeof(Matrix4D));
+    streamBufferUnmap(stream);
+
+    StreamAllocation commands;
+    if(indirect)
+    {
+        commands = streamBufferMap(stream, pool.commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+        std::memcpy(commands.data, pool.commands.data(), pool.commands.size() * sizeof(DrawElementsIndirectCommand));
+        streamBufferUnmap(stream);
+    }
+
+    glStateBindVertexArray(pool.vao);
+    glStateBindBuffer(GL_ARRAY_BUFFER, stream.id);
+
+    if(indirect)
+    {
+        detail::setModelAttribPointer(models.offset);
+
+        glStateBindBuffer(GL_DRAW_INDIRECT_BUFFER, stream.id);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*) commands.offset, pool.commands.size(), 0);
+    }
+    else
+    {
+        /* without base instances the model matrix attribute is re-pointed for every draw */
+        for(const DrawElementsIndirectCommand& command : pool.commands)
+        {
+            detail::setModelAttribPointer(models.offset + command.baseInstance * sizeof(Matrix4D));
+            glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+                                     (void*) (command.firstIndex * sizeof(unsigned int)), command.baseVertex);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "base.h"
+#include "resource.h"
+#include "streambuffer.h"
+
+#include <map>
+#include <vector>
+
+struct Mesh;
+
+/* vertex attribute location of the per-draw model matrix (occupies four consecutive locations) */
+enum eInstanceDataIdx { Model = 2 };
+
+/* layout of one indirect draw as consumed by glMultiDrawElementsIndirect */
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/* first-fit free list over a range of elements, neighbouring free blocks are merged on release */
+struct FreeListAllocator
+{
+    unsigned int capacity = 0;
+    unsigned int used = 0;
+    std::map<unsigned int, unsigned int> freeBlocks; // offset -> size
+};
+
+struct MegaBuffer
+{
+    VertexArrayHandle vao;
+    BufferHandle vbo;
+    BufferHandle ebo;
+
+    FreeListAllocator vertexAllocator;
+    FreeListAllocator indexAllocator;
+
+    /* draws collected for the current submission */
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<Matrix4D> models;
+};
+
+/**
+ * @brief Reserves a block of elements from a free list allocator.
+ *
+ * @param allocator Allocator to take the block from.
+ * @param size Number of elements.
+ *
+ * @return Offset of the block or ~0u if no free block is large enough.
+ */
+unsigned int freeListAlloc(FreeListAllocator& allocator, unsigned int size);
+
+/**
+ * @brief Returns a block of elements to a free list allocator.
+ *
+ * @param allocator Allocator the block was taken from.
+ * @param offset Offset of the block.
+ * @param size Number of elements.
+ */
+void freeListFree(FreeListAllocator& allocator, unsigned int offset, unsigned int size);
+
+/**
+ * @brief Creates one large vertex and one large index buffer with a shared VAO from which meshes can be suballocated
+ * (see meshCreate(MegaBuffer&, ...)). All meshes of a mega buffer can be drawn with a single indirect multi draw.
+ *
+ * @param vertexCapacity Maximum number of vertices.
+ * @param indexCapacity Maximum number of indices.
+ *
+ * @return Initialized mega buffer.
+ *
+ * usage:
+ *
+ *   MegaBuffer pool = megaBufferCreate(1 << 16, 1 << 18);
+ *   Mesh myMesh = meshCreate(pool, vertex-data, index-data);
+ *   megaBufferDrawBegin(pool);
+ *   megaBufferDrawAdd(pool, myMesh, modelMatrix);
+ *   megaBufferDrawSubmit(pool, stream);
+ */
+MegaBuffer megaBufferCreate(unsigned int vertexCapacity, unsigned int indexCapacity);
+
+/**
+ * @brief Cleanup and delete all OpenGL buffers of a mega buffer. Meshes allocated from it become invalid.
+ *
+ * @param pool Mega buffer to delete.
+ */
+void megaBufferDelete(MegaBuffer& pool);
+
+/**
+ * @brief Clears the list of draws collected for the next submission.
+ *
+ * @param pool Mega buffer.
+ */
+void megaBufferDrawBegin(MegaBuffer& pool);
+
+/**
+ * @brief Adds a draw of a mesh allocated from the mega buffer to the next submission.
+ *
+ * @param pool Mega buffer the mesh was allocated from.
+ * @param mesh Mesh to draw.
+ * @param model Model matrix of the draw (passed to the vertex shader as per-instance attribute aModel).
+ * @param lod Level of detail to draw if the mesh has LODs (see meshSelectLod(...)).
+ */
+void megaBufferDrawAdd(MegaBuffer& pool, const Mesh& mesh, const Matrix4D& model, unsigned int lod = 0);
+
+/**
+ * @brief Writes model matrices and indirect commands of all collected draws into the stream buffer and issues them with
+ * one glMultiDrawElementsIndirect. Falls back to one glDrawElementsBaseVertex per draw if indirect multi draws or base
+ * instances are not supported. The shader program has to be bound by the caller.
+ *
+ * @param pool Mega buffer.
+ * @param stream Stream buffer receiving the per-frame draw data.
+ */
+void megaBufferDrawSubmit(MegaBuffer& pool, StreamBuffer& stream);
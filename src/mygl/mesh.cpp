@@ -1,22 +1,23 @@
 #include "mesh.h"
+#include "arena.h"
+#include "glstate.h"
+#include "meshfile.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
 
 Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, GLenum vertexBufferUsage, GLenum indexBufferUsage)
 {
-    GLuint vao = 0, vbo = 0, ebo = 0;
-
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    Mesh mesh;
+    mesh.vao = vertexArrayCreate();
+    mesh.vbo = bufferCreate();
+    mesh.ebo = bufferCreate();
 
-    glBindVertexArray(vao);
+    glStateBindVertexArray(mesh.vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
-        glCheckError();
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
-        glCheckError();
+        bufferData(mesh.vbo, GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
+        bufferData(mesh.ebo, GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
 
         glEnableVertexAttribArray(eDataIdx::Position);
         glEnableVertexAttribArray(eDataIdx::Color);
@@ -25,34 +26,30 @@ Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned
         glCheckError();
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    /* unbind so later element array binds can't modify this VAO */
+    glStateBindVertexArray(0);
 
-    return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
+    mesh.size_vbo = vertices.size();
+    mesh.size_ibo = indices.size();
+    return mesh;
 }
 
 Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color, GLenum vertexBufferUsage, GLenum indexBufferUsage) {
-    GLuint vao = 0, vbo = 0, ebo = 0;
-
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
-
-    std::vector<Vertex> vertices(positions.size());
-    for (unsigned i=0; i<vertices.size(); i++) {
+    Mesh mesh;
+    mesh.vao = vertexArrayCreate();
+    mesh.vbo = bufferCreate();
+    mesh.ebo = bufferCreate();
+
+    /* interleave into the staging arena instead of a temporary vector */
+    Vertex* vertices = arenaAllocArray<Vertex>(arenaStaging(), positions.size());
+    for (unsigned i=0; i<positions.size(); i++) {
         vertices[i] = {positions[i], color};
     }
 
-    glBindVertexArray(vao);
+    glStateBindVertexArray(mesh.vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
-        glCheckError();
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
-        glCheckError();
+        bufferData(mesh.vbo, GL_ARRAY_BUFFER, positions.size() * sizeof(Vertex), vertices, vertexBufferUsage);
+        bufferData(mesh.ebo, GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
 
         glEnableVertexAttribArray(eDataIdx::Position);
         glEnableVertexAttribArray(eDataIdx::Color);
@@ -61,16 +58,108 @@ Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsign
         glCheckError();
     }
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    /* unbind so later element array binds can't modify this VAO */
+    glStateBindVertexArray(0);
 
-    return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
+    mesh.size_vbo = positions.size();
+    mesh.size_ibo = indices.size();
+    return mesh;
 }
 
-void meshDelete(const Mesh &mesh)
+namespace detail
 {
-    glDeleteBuffers(1, &mesh.vbo);
-    glDeleteBuffers(1, &mesh.ebo);
-    glDeleteVertexArrays(1, &mesh.vao);
+    void computeBounds(Mesh& mesh, const Vertex* vertices, unsigned int vertexCount)
+    {
+        if(vertexCount == 0)
+        {
+            return;
+        }
+
+        Vector3D min = vertices[0].pos;
+        Vector3D max = vertices[0].pos;
+        for(unsigned int i = 1; i < vertexCount; i++)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                min[k] = std::min(min[k], vertices[i].pos[k]);
+                max[k] = std::max(max[k], vertices[i].pos[k]);
+            }
+        }
+
+        mesh.boundsCenter = 0.5f * (min + max);
+        mesh.boundsRadius = 0.0f;
+        for(unsigned int i = 0; i < vertexCount; i++)
+        {
+            mesh.boundsRadius = std::max(mesh.boundsRadius, length(vertices[i].pos - mesh.boundsCenter));
+        }
+    }
+
+    Mesh createPooled(MegaBuffer& pool, const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+    {
+        unsigned int baseVertex = freeListAlloc(pool.vertexAllocator, vertexCount);
+        unsigned int firstIndex = freeListAlloc(pool.indexAllocator, indexCount);
+        if(baseVertex == ~0u || firstIndex == ~0u)
+        {
+            freeListFree(pool.vertexAllocator, baseVertex, baseVertex == ~0u ? 0 : vertexCount);
+            freeListFree(pool.indexAllocator, firstIndex, firstIndex == ~0u ? 0 : indexCount);
+
+            std::cerr << "[Mesh] Mega buffer is out of space" << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Mesh] Mega buffer is out of space");
+        }
+
+        glStateBindBuffer(GL_ARRAY_BUFFER, pool.vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, baseVertex * sizeof(Vertex), vertexCount * sizeof(Vertex), vertices);
+        glCheckError();
+
+        /* the element array binding is VAO state, upload through the copy target instead */
+        glStateBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indexCount * sizeof(unsigned int), indices);
+        glCheckError();
+
+        Mesh mesh;
+        mesh.size_vbo = vertexCount;
+        mesh.size_ibo = indexCount;
+        mesh.pool = &pool;
+        mesh.baseVertex = baseVertex;
+        mesh.firstIndex = firstIndex;
+        computeBounds(mesh, vertices, vertexCount);
+        return mesh;
+    }
+}
+
+Mesh meshCreate(MegaBuffer& pool, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    return detail::createPooled(pool, vertices.data(), vertices.size(), indices.data(), indices.size());
+}
+
+Mesh meshCreate(MegaBuffer& pool, const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color)
+{
+    Vertex* vertices = arenaAllocArray<Vertex>(arenaStaging(), positions.size());
+    for (unsigned i=0; i<positions.size(); i++) {
+        vertices[i] = {positions[i], color};
+    }
+
+    return detail::createPooled(pool, vertices, positions.size(), indices.data(), indices.size());
+}
+
+Mesh meshCreate(MegaBuffer& pool, const MeshFile& file)
+{
+    /* the blobs are uploaded straight from the file mapping */
+    return detail::createPooled(pool, file.vertices, file.header->vertexCount, file.indices, file.header->indexCount);
+}
+
+void meshDelete(Mesh &mesh)
+{
+    if(mesh.pool)
+    {
+        freeListFree(mesh.pool->vertexAllocator, mesh.baseVertex, mesh.size_vbo);
+        freeListFree(mesh.pool->indexAllocator, mesh.firstIndex, mesh.size_ibo);
+        for(unsigned int i = 1; i < mesh.lods.size(); i++)
+        {
+            freeListFree(mesh.pool->indexAllocator, mesh.lods[i].firstIndex, mesh.lods[i].count);
+        }
+    }
+
+    mesh = Mesh();
 }
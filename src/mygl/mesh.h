@@ -1,6 +1,8 @@
 #pragma once
 
 #include "base.h"
+#include "megabuffer.h"
+#include "resource.h"
 
 #include <vector>
 
@@ -13,14 +15,35 @@ struct Vertex
 };
 
 
+/* range of the index buffer holding one level of detail */
+struct MeshLod
+{
+    GLuint firstIndex = 0;
+    unsigned int count = 0;
+    float error = 0.0f;
+};
+
 struct Mesh
 {
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    GLuint ebo = 0;
+    /* owned buffers, empty if the mesh was allocated from a mega buffer */
+    VertexArrayHandle vao;
+    BufferHandle vbo;
+    BufferHandle ebo;
 
     unsigned int size_vbo = 0;
     unsigned int size_ibo = 0;
+
+    /* offsets into the shared buffers if the mesh was allocated from a mega buffer */
+    MegaBuffer* pool = nullptr;
+    GLint baseVertex = 0;
+    GLuint firstIndex = 0;
+
+    /* bounding sphere in object space */
+    Vector3D boundsCenter;
+    float boundsRadius = 0.0f;
+
+    /* optional levels of detail, lods[0] is the full detail mesh (see meshAddLods) */
+    std::vector<MeshLod> lods;
 };
 
 /**
@@ -65,8 +88,42 @@ Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned
 Mesh meshCreate(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color, GLenum vertexBufferUsage, GLenum indexBufferUsage);
 
 /**
- * @brief Cleanup and delete all OpenGL buffers of a mesh. Has to be called for each mesh after it is not used anymore.
+ * @brief Suballocates vertices and indices of a mesh from a mega buffer and uploads the data. The returned mesh uses
+ * the VAO and buffers of the mega buffer and can be drawn with glDrawElementsBaseVertex or megaBufferDrawAdd(...).
+ *
+ * @param pool Mega buffer to allocate from.
+ * @param vertices Data for each vertex of the mesh.
+ * @param indices List of indices that form polygons in the mesh.
+ *
+ * @return Initialized mesh structure that refers to its range in the mega buffer.
+ *
+ * usage:
+ *
+ *   Mesh myMesh = meshCreate(pool, vertex-data, index-data);
+ *   glBindVertexArray(pool.vao);
+ *   glDrawElementsBaseVertex(GL_TRIANGLES, myMesh.size_ibo, GL_UNSIGNED_INT,
+ *                            (void*) (myMesh.firstIndex * sizeof(unsigned int)), myMesh.baseVertex);
+ *
+ */
+Mesh meshCreate(MegaBuffer& pool, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+/**
+ * @brief Suballocates vertices and indices of a mesh from a mega buffer and uploads the data.
+ *
+ * @param pool Mega buffer to allocate from.
+ * @param positions Position data for each vertex of the mesh.
+ * @param indices List of indices that form polygons in the mesh.
+ * @param color Color used for each of the vertices of this mesh.
+ *
+ * @return Initialized mesh structure that refers to its range in the mega buffer.
+ */
+Mesh meshCreate(MegaBuffer& pool, const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color);
+
+/**
+ * @brief Cleanup and delete all OpenGL buffers of a mesh. Meshes allocated from a mega buffer release their range instead. Has to be called for each mesh after it is not used anymore.
+ * The buffers of standalone meshes are also released when the mesh is destroyed, the actual deletion is deferred until
+ * the GPU finished the frame (see resourceFrameEnd()).
  *
  * @param mesh Mesh to delete.
  */
-void meshDelete(const Mesh& mesh);
+void meshDelete(Mesh& mesh);
@@ -0,0 +1,236 @@
+#include "meshfile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace detail
+{
+    uint64_t alignOffset(uint64_t offset)
+    {
+        return (offset + MESHFILE_ALIGNMENT - 1) / MESHFILE_ALIGNMENT * MESHFILE_ALIGNMENT;
+    }
+
+    [[noreturn]] void fail(const std::string& message)
+    {
+        std::cerr << "[MeshFile] " << message << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[MeshFile] " + message);
+    }
+
+    void* mapFile(const std::string& filepath, size_t& size)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if(file == INVALID_HANDLE_VALUE)
+        {
+            return nullptr;
+        }
+
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        size = static_cast<size_t>(fileSize.QuadPart);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if(!mapping)
+        {
+            return nullptr;
+        }
+
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        return data;
+#else
+        int fd = open(filepath.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return nullptr;
+        }
+
+        struct stat info;
+        if(fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+        size = static_cast<size_t>(info.st_size);
+
+        void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(data == MAP_FAILED)
+        {
+            return nullptr;
+        }
+
+        /* the whole file is uploaded right away */
+        madvise(data, size, MADV_WILLNEED);
+        return data;
+#endif
+    }
+
+    void unmapFile(void* data, size_t size)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(data, size);
+#endif
+    }
+
+    /* written so that offset + count * stride can't wrap around */
+    bool rangeInFile(uint64_t offset, uint64_t count, uint64_t stride, size_t size)
+    {
+        return offset <= size && count <= (size - offset) / stride;
+    }
+
+    /* the blobs are uploaded without conversion, so the stored layout has to match Vertex */
+    bool layoutMatchesVertex(const MeshFileHeader& header)
+    {
+        if(header.vertexStride != sizeof(Vertex) || header.attributeCount != 2)
+        {
+            return false;
+        }
+
+        const MeshFileAttribute& position = header.attributes[0];
+        const MeshFileAttribute& color = header.attributes[1];
+        return position.location == eDataIdx::Position && position.components == 3 && position.type == eMeshFileAttribType::Float32
+               && position.offset == offsetof(Vertex, pos)
+               && color.location == eDataIdx::Color && color.components == 4 && color.type == eMeshFileAttribType::Float32
+               && color.offset == offsetof(Vertex, color);
+    }
+}
+
+void meshFileWrite(const std::string& filepath, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices)
+{
+    MeshFileHeader header = {};
+    header.magic = MESHFILE_MAGIC;
+    header.version = MESHFILE_VERSION;
+    header.vertexCount = vertices.size();
+    header.indexCount = indices.size();
+    header.vertexStride = sizeof(Vertex);
+    header.attributeCount = 2;
+    header.attributes[0] = {eDataIdx::Position, 3, eMeshFileAttribType::Float32, offsetof(Vertex, pos)};
+    header.attributes[1] = {eDataIdx::Color, 4, eMeshFileAttribType::Float32, offsetof(Vertex, color)};
+    header.vertexOffset = detail::alignOffset(sizeof(MeshFileHeader));
+    header.indexOffset = detail::alignOffset(header.vertexOffset + vertices.size() * sizeof(Vertex));
+
+    for(unsigned int k = 0; k < 3; k++)
+    {
+        header.boundsMin[k] = std::numeric_limits<float>::max();
+        header.boundsMax[k] = std::numeric_limits<float>::lowest();
+    }
+    for(const Vertex& vertex : vertices)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            header.boundsMin[k] = std::min(header.boundsMin[k], vertex.pos[k]);
+            header.boundsMax[k] = std::max(header.boundsMax[k], vertex.pos[k]);
+        }
+    }
+
+    std::ofstream file(filepath, std::ios::binary);
+    if(!file.is_open())
+    {
+        detail::fail("Couldn't open mesh file for writing at " + filepath);
+    }
+
+    const char padding[MESHFILE_ALIGNMENT] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(padding, header.vertexOffset - sizeof(header));
+    file.write(reinterpret_cast<const char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+    file.write(padding, header.indexOffset - (header.vertexOffset + vertices.size() * sizeof(Vertex)));
+    file.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+
+    if(!file.good())
+    {
+        detail::fail("Couldn't write mesh file " + filepath);
+    }
+}
+
+MeshFile meshFileOpen(const std::string& filepath)
+{
+    MeshFile file;
+    file.mapping = detail::mapFile(filepath, file.size);
+    if(!file.mapping)
+    {
+        detail::fail("Couldn't open mesh file at " + filepath);
+    }
+
+    const MeshFileHeader* header = static_cast<const MeshFileHeader*>(file.mapping);
+    std::string error;
+    if(file.size < sizeof(MeshFileHeader) || header->magic != MESHFILE_MAGIC)
+    {
+        error = "Not a mesh file: " + filepath;
+    }
+    else if(header->version != MESHFILE_VERSION)
+    {
+        error = "Unsupported mesh file version " + std::to_string(header->version) + " in " + filepath;
+    }
+    else if(!detail::layoutMatchesVertex(*header))
+    {
+        error = "Unsupported vertex layout in " + filepath;
+    }
+    else if(header->vertexOffset % MESHFILE_ALIGNMENT != 0 || header->indexOffset % MESHFILE_ALIGNMENT != 0)
+    {
+        error = "Misaligned vertex or index data in " + filepath;
+    }
+    else if(!detail::rangeInFile(header->vertexOffset, header->vertexCount, header->vertexStride, file.size)
+            || !detail::rangeInFile(header->indexOffset, header->indexCount, sizeof(unsigned int), file.size))
+    {
+        error = "Truncated mesh file " + filepath;
+    }
+    else if(header->indexCount % 3 != 0)
+    {
+        error = "Index count " + std::to_string(header->indexCount) + " is not a triangle list in " + filepath;
+    }
+    else
+    {
+        /* the indices are copied into a shared mega buffer, one out of range would read another mesh's vertices */
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(
+            static_cast<const unsigned char*>(file.mapping) + header->indexOffset);
+        unsigned int maxIndex = 0;
+        for(uint32_t i = 0; i < header->indexCount; i++)
+        {
+            maxIndex = std::max(maxIndex, indices[i]);
+        }
+        if(header->indexCount > 0 && maxIndex >= header->vertexCount)
+        {
+            error = "Index " + std::to_string(maxIndex) + " out of range of " + std::to_string(header->vertexCount)
+                    + " vertices in " + filepath;
+        }
+    }
+
+    if(!error.empty())
+    {
+        meshFileClose(file);
+        detail::fail(error);
+    }
+
+    const unsigned char* base = static_cast<const unsigned char*>(file.mapping);
+    file.header = header;
+    file.vertices = reinterpret_cast<const Vertex*>(base + header->vertexOffset);
+    file.indices = reinterpret_cast<const unsigned int*>(base + header->indexOffset);
+    return file;
+}
+
+void meshFileClose(MeshFile& file)
+{
+    if(file.mapping)
+    {
+        detail::unmapFile(file.mapping, file.size);
+    }
+    file = MeshFile();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define MESHFILE_MAGIC 0x4853454Du // "MESH" in little endian
+#define MESHFILE_VERSION 1u
+#define MESHFILE_ALIGNMENT 64u
+#define MESHFILE_MAX_ATTRIBUTES 8u
+
+enum eMeshFileAttribType : uint32_t { Float32 = 0 };
+
+/* one vertex attribute inside the interleaved vertex blob */
+struct MeshFileAttribute
+{
+    uint32_t location;   // shader attribute location (see eDataIdx)
+    uint32_t components;
+    uint32_t type;       // eMeshFileAttribType
+    uint32_t offset;     // byte offset inside a vertex
+};
+
+/* file header, vertex and index blobs follow at aligned offsets */
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t vertexStride;
+    uint32_t attributeCount;
+    MeshFileAttribute attributes[MESHFILE_MAX_ATTRIBUTES];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct MeshFile
+{
+    const MeshFileHeader* header = nullptr;
+    const Vertex* vertices = nullptr;
+    const unsigned int* indices = nullptr;
+
+    /* memory mapping of the whole file */
+    void* mapping = nullptr;
+    size_t size = 0;
+};
+
+/**
+ * @brief Writes vertex and index data into a binary mesh file that can be memory mapped by meshFileOpen(...).
+ *
+ * @param filepath Path to output file.
+ * @param vertices Data for each vertex of the mesh.
+ * @param indices List of indices that form triangles in the mesh.
+ */
+void meshFileWrite(const std::string& filepath, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices);
+
+/**
+ * @brief Memory maps a binary mesh file and validates its header, vertex layout, blob alignment and bounds, and that
+ * the indices form triangles referencing existing vertices. No data is copied, the returned pointers point into the
+ * mapping.
+ *
+ * @param filepath Path to the mesh file.
+ *
+ * @return Mapped mesh file, has to be closed with meshFileClose(...).
+ *
+ * usage:
+ *
+ *   MeshFile file = meshFileOpen("vehicle.mesh");
+ *   Mesh myMesh = meshCreate(pool, file);
+ *   meshFileClose(file);
+ */
+MeshFile meshFileOpen(const std::string& filepath);
+
+/**
+ * @brief Unmaps a mesh file opened with meshFileOpen(...).
+ *
+ * @param file Mesh file to close.
+ */
+void meshFileClose(MeshFile& file);
+
+/**
+ * @brief Uploads a mapped mesh file straight into a mega buffer.
+ *
+ * @param pool Mega buffer to allocate from.
+ * @param file Mapped mesh file.
+ *
+ * @return Initialized mesh structure that refers to its range in the mega buffer.
+ */
+Mesh meshCreate(MegaBuffer& pool, const MeshFile& file);
@@ -0,0 +1,350 @@
+#include "meshlod.h"
+#include "meshopt.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace detail
+{
+    /* symmetric 4x4 matrix of a quadric, stored as upper triangle */
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+
+        Quadric& operator+=(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            return *this;
+        }
+    };
+
+    Quadric planeQuadric(const Vector3D& n, double d)
+    {
+        Quadric q;
+        q.a00 = n.x * n.x; q.a01 = n.x * n.y; q.a02 = n.x * n.z; q.a03 = n.x * d;
+        q.a11 = n.y * n.y; q.a12 = n.y * n.z; q.a13 = n.y * d;
+        q.a22 = n.z * n.z; q.a23 = n.z * d;
+        q.a33 = d * d;
+        return q;
+    }
+
+    /* sum of squared distances of p to all planes of the quadric */
+    double quadricError(const Quadric& q, const Vector3D& p)
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = q.a00 * x * x + 2 * q.a01 * x * y + 2 * q.a02 * x * z + 2 * q.a03 * x
+                      + q.a11 * y * y + 2 * q.a12 * y * z + 2 * q.a13 * y
+                      + q.a22 * z * z + 2 * q.a23 * z
+                      + q.a33;
+        return std::max(result, 0.0);
+    }
+
+    uint64_t edgeKey(unsigned int a, unsigned int b)
+    {
+        return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+    }
+
+    struct Collapse
+    {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    /* whether moving vertex "from" onto "to" flips or degenerates one of the triangles around "from" */
+    bool collapseFlips(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices,
+                       const std::vector<unsigned int>& triangles, unsigned int from, unsigned int to)
+    {
+        for(unsigned int t : triangles)
+        {
+            unsigned int i0 = indices[t * 3 + 0], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+            if(i0 == to || i1 == to || i2 == to)
+            {
+                continue; // removed by the collapse
+            }
+
+            Vector3D p0 = positions[i0], p1 = positions[i1], p2 = positions[i2];
+            Vector3D before = cross(p1 - p0, p2 - p0);
+
+            (i0 == from ? p0 : i1 == from ? p1 : p2) = positions[to];
+            Vector3D after = cross(p1 - p0, p2 - p0);
+
+            if(dot(before, after) <= 0.0f)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+std::vector<unsigned int> meshSimplify(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, unsigned int targetIndexCount, float& error)
+{
+    unsigned int vertexCount = positions.size();
+    std::vector<unsigned int> result = indices;
+    double maxCost = 0.0;
+
+    /* plane quadrics of all adjacent triangles */
+    std::vector<detail::Quadric> quadrics(vertexCount);
+    for(unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        const Vector3D& p0 = positions[indices[i + 0]];
+        Vector3D n = cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+        float area = length(n);
+        if(area <= 0.0f)
+        {
+            continue;
+        }
+        n = n / area;
+
+        detail::Quadric q = detail::planeQuadric(n, -dot(n, p0));
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            quadrics[indices[i + k]] += q;
+        }
+    }
+
+    /* edges used by only one triangle are open borders, their vertices stay locked */
+    std::unordered_map<uint64_t, unsigned int> edgeUse;
+    for(unsigned int i = 0; i < indices.size(); i += 3)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            edgeUse[detail::edgeKey(indices[i + k], indices[i + (k + 1) % 3])]++;
+        }
+    }
+    std::vector<bool> locked(vertexCount, false);
+    for(const auto& edge : edgeUse)
+    {
+        if(edge.second == 1)
+        {
+            locked[edge.first >> 32] = true;
+            locked[edge.first & 0xffffffffu] = true;
+        }
+    }
+
+    std::vector<detail::Collapse> collapses;
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+
+    while(result.size() > targetIndexCount)
+    {
+        /* cheapest direction of every edge */
+        collapses.clear();
+        for(unsigned int i = 0; i < result.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k];
+                unsigned int b = result[i + (k + 1) % 3];
+                if(a > b)
+                {
+                    continue; // every inner edge is visited from both triangles, keep one
+                }
+
+                detail::Quadric q = quadrics[a];
+                q += quadrics[b];
+                double costAB = locked[a] ? std::numeric_limits<double>::max() : detail::quadricError(q, positions[b]);
+                double costBA = locked[b] ? std::numeric_limits<double>::max() : detail::quadricError(q, positions[a]);
+                if(locked[a] && locked[b])
+                {
+                    continue;
+                }
+                collapses.push_back(costAB <= costBA ? detail::Collapse{a, b, costAB} : detail::Collapse{b, a, costBA});
+            }
+        }
+
+        if(collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const detail::Collapse& x, const detail::Collapse& y) { return x.cost < y.cost; });
+
+        /* vertex -> triangle adjacency of the current triangle list */
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for(unsigned int index : result)
+        {
+            adjacencyOffsets[index + 1]++;
+        }
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for(unsigned int i = 0; i < result.size(); i++)
+        {
+            adjacency[fill[result[i]]++] = i / 3;
+        }
+
+        /* apply independent collapses in order of cost, each removes about two triangles */
+        for(unsigned int v = 0; v < vertexCount; v++)
+        {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        unsigned int removable = (result.size() - targetIndexCount) / 3;
+        unsigned int removed = 0;
+        for(const detail::Collapse& collapse : collapses)
+        {
+            if(removed >= removable)
+            {
+                break;
+            }
+            if(touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            std::vector<unsigned int> triangles(adjacency.begin() + adjacencyOffsets[collapse.from], adjacency.begin() + adjacencyOffsets[collapse.from + 1]);
+            if(detail::collapseFlips(positions, result, triangles, collapse.from, collapse.to))
+            {
+                continue;
+            }
+
+            /* the neighbourhood changes, so no further collapse may touch it in this pass */
+            for(unsigned int t : triangles)
+            {
+                for(unsigned int k = 0; k < 3; k++)
+                {
+                    touched[result[t * 3 + k]] = true;
+                    removed += (result[t * 3 + k] == collapse.to) ? 1 : 0;
+                }
+            }
+            for(unsigned int i = adjacencyOffsets[collapse.to]; i < adjacencyOffsets[collapse.to + 1]; i++)
+            {
+                for(unsigned int k = 0; k < 3; k++)
+                {
+                    touched[result[adjacency[i] * 3 + k]] = true;
+                }
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxCost = std::max(maxCost, collapse.cost);
+        }
+
+        /* rewrite the triangle list and drop collapsed triangles */
+        unsigned int write = 0;
+        for(unsigned int i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i + 0]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if(a == b || b == c || c == a)
+            {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+
+        if(write == result.size())
+        {
+            break; // no collapse possible anymore
+        }
+        result.resize(write);
+    }
+
+    error = static_cast<float>(std::sqrt(maxCost));
+    return result;
+}
+
+std::vector<MeshLodLevel> meshGenerateLods(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, unsigned int maxLevels, float reduction)
+{
+    std::vector<MeshLodLevel> levels;
+    levels.push_back({indices, 0.0f});
+
+    while(levels.size() < maxLevels)
+    {
+        const MeshLodLevel& previous = levels.back();
+        unsigned int target = static_cast<unsigned int>(previous.indices.size() / 3 * reduction) * 3;
+
+        MeshLodLevel level;
+        level.indices = meshSimplify(positions, indices, target, level.error);
+
+        /* stop once the simplifier cannot reduce the mesh noticeably anymore */
+        if(level.indices.empty() || level.indices.size() > previous.indices.size() * 0.9f)
+        {
+            break;
+        }
+
+        meshOptimizeVertexCache(level.indices, positions.size());
+        level.error = std::max(level.error, previous.error);
+        levels.push_back(std::move(level));
+    }
+
+    return levels;
+}
+
+std::vector<MeshLodLevel> meshGenerateLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int maxLevels, float reduction)
+{
+    std::vector<Vector3D> positions(vertices.size());
+    for(unsigned int i = 0; i < vertices.size(); i++)
+    {
+        positions[i] = vertices[i].pos;
+    }
+    return meshGenerateLods(positions, indices, maxLevels, reduction);
+}
+
+void meshAddLods(Mesh& mesh, const std::vector<MeshLodLevel>& levels)
+{
+    MegaBuffer& pool = *mesh.pool;
+
+    mesh.lods.clear();
+    mesh.lods.push_back({mesh.firstIndex, mesh.size_ibo, 0.0f});
+
+    for(unsigned int i = 1; i < levels.size(); i++)
+    {
+        const std::vector<unsigned int>& indices = levels[i].indices;
+        unsigned int firstIndex = freeListAlloc(pool.indexAllocator, indices.size());
+        if(firstIndex == ~0u)
+        {
+            break; // keep the levels uploaded so far
+        }
+
+        glStateBindBuffer(GL_COPY_WRITE_BUFFER, pool.ebo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, firstIndex * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+        glCheckError();
+
+        mesh.lods.push_back({firstIndex, (unsigned int) indices.size(), levels[i].error});
+    }
+}
+
+unsigned int meshSelectLod(const Mesh& mesh, const Matrix4D& model, const Camera& cam, float pixelThreshold)
+{
+    if(mesh.lods.size() < 2)
+    {
+        return 0;
+    }
+
+    /* the largest axis scale bounds the world space error */
+    float scale = std::max({length(Vector3D(model[0])), length(Vector3D(model[1])), length(Vector3D(model[2]))});
+    Vector3D center = Vector3D(model * Vector4D(mesh.boundsCenter, 1.0f));
+    float distance = std::max(length(center - cam.position) - mesh.boundsRadius * scale, cam.nearPlane);
+
+    /* pixels per world unit at this distance */
+    float pixelsPerUnit = cam.height / (2.0f * std::tan(cam.fov * 0.5f) * distance);
+
+    unsigned int lod = 0;
+    for(unsigned int i = 1; i < mesh.lods.size(); i++)
+    {
+        if(mesh.lods[i].error * scale * pixelsPerUnit > pixelThreshold)
+        {
+            break;
+        }
+        lod = i;
+    }
+    return lod;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "camera.h"
+#include "mesh.h"
+
+#include <vector>
+
+struct MeshLodLevel
+{
+    std::vector<unsigned int> indices;
+    float error = 0.0f; // maximum geometric deviation from the full detail mesh in object space
+};
+
+/**
+ * @brief Simplifies a triangle mesh with quadric error metrics (Garland & Heckbert 1997) by collapsing edges onto one
+ * of their end points, so the vertex buffer can be shared with the full detail mesh. Vertices on open borders are kept
+ * in place to avoid cracks and shrinking.
+ *
+ * @param positions Vertex positions.
+ * @param indices Triangle list.
+ * @param targetIndexCount Number of indices at which the simplification stops.
+ * @param error Receives the geometric error of the result in object space.
+ *
+ * @return Simplified triangle list referencing the same vertices.
+ */
+std::vector<unsigned int> meshSimplify(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, unsigned int targetIndexCount, float& error);
+
+/**
+ * @brief Generates a chain of successively simplified index lists. The first level is the input mesh, every further
+ * level has about reduction times the triangles of the previous one. The chain ends early once the simplification gets
+ * stuck.
+ *
+ * @param positions Vertex positions.
+ * @param indices Triangle list of the full detail mesh.
+ * @param maxLevels Maximum number of levels including the full detail mesh.
+ * @param reduction Triangle ratio between successive levels.
+ *
+ * @return LOD levels ordered from full to lowest detail.
+ */
+std::vector<MeshLodLevel> meshGenerateLods(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, unsigned int maxLevels = 4, float reduction = 0.5f);
+
+/**
+ * @brief Generates a chain of successively simplified index lists for interleaved vertex data
+ * (see meshGenerateLods(const std::vector<Vector3D>&, ...)).
+ */
+std::vector<MeshLodLevel> meshGenerateLods(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, unsigned int maxLevels = 4, float reduction = 0.5f);
+
+/**
+ * @brief Uploads the coarser levels of a LOD chain into the mega buffer of a pooled mesh. The levels share the vertex
+ * range of the mesh and are released with it.
+ *
+ * @param mesh Mesh allocated from a mega buffer with the indices of the first level.
+ * @param levels LOD chain created by meshGenerateLods(...).
+ */
+void meshAddLods(Mesh& mesh, const std::vector<MeshLodLevel>& levels);
+
+/**
+ * @brief Selects the coarsest LOD of a mesh whose geometric error projects to less than the given number of pixels,
+ * based on the distance of the transformed mesh bounds to the camera and the camera's vertical field of view.
+ *
+ * @param mesh Mesh with LOD levels (see meshAddLods(...)).
+ * @param model Model matrix of the mesh.
+ * @param cam Camera the mesh is rendered with.
+ * @param pixelThreshold Maximum allowed screen space error in pixels.
+ *
+ * @return Index of the LOD level to draw.
+ */
+unsigned int meshSelectLod(const Mesh& mesh, const Matrix4D& model, const Camera& cam, float pixelThreshold = 1.0f);
@@ -0,0 +1,346 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+namespace detail
+{
+    /* triangles adjacent to each vertex, stored as offsets into one flat array */
+    struct Adjacency
+    {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> triangles;
+    };
+
+    Adjacency buildAdjacency(const std::vector<unsigned int>& indices, unsigned int vertexCount)
+    {
+        Adjacency adjacency;
+        adjacency.offsets.assign(vertexCount + 1, 0);
+        adjacency.triangles.resize(indices.size());
+
+        for(unsigned int index : indices)
+        {
+            adjacency.offsets[index + 1]++;
+        }
+        std::partial_sum(adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin());
+
+        std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+        for(unsigned int i = 0; i < indices.size(); i++)
+        {
+            adjacency.triangles[fill[indices[i]]++] = i / 3;
+        }
+
+        return adjacency;
+    }
+
+    /* number of cache misses of each triangle when drawn in the given order */
+    std::vector<unsigned int> simulateCacheMisses(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+    {
+        std::vector<unsigned int> misses(indices.size() / 3, 0);
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        unsigned int time = cacheSize + 1;
+
+        for(unsigned int i = 0; i < indices.size(); i++)
+        {
+            unsigned int v = indices[i];
+            if(time - timestamps[v] > cacheSize)
+            {
+                timestamps[v] = time++;
+                misses[i / 3]++;
+            }
+        }
+
+        return misses;
+    }
+
+    int tipsifyNextVertex(const std::vector<unsigned int>& candidates, const std::vector<unsigned int>& liveTriangles,
+                          const std::vector<unsigned int>& cacheTime, unsigned int time, unsigned int cacheSize,
+                          std::vector<unsigned int>& deadEnd, unsigned int& cursor, unsigned int vertexCount)
+    {
+        /* prefer candidates that stay in the cache while their remaining triangles are emitted */
+        int best = -1;
+        int bestPriority = -1;
+        for(unsigned int v : candidates)
+        {
+            if(liveTriangles[v] == 0)
+            {
+                continue;
+            }
+
+            int priority = 0;
+            if(time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+            {
+                priority = time - cacheTime[v];
+            }
+
+            if(priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        if(best >= 0)
+        {
+            return best;
+        }
+
+        /* dead end: fall back to recently used vertices, then to the next vertex in input order */
+        while(!deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if(liveTriangles[v] > 0)
+            {
+                return v;
+            }
+        }
+
+        while(cursor < vertexCount)
+        {
+            if(liveTriangles[cursor] > 0)
+            {
+                return cursor;
+            }
+            cursor++;
+        }
+
+        return -1;
+    }
+
+    Vector3D triangleNormal(const Vector3D& a, const Vector3D& b, const Vector3D& c)
+    {
+        return cross(b - a, c - a);
+    }
+}
+
+VertexCacheStats meshAnalyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if(indices.empty() || vertexCount == 0)
+    {
+        return stats;
+    }
+
+    std::vector<unsigned int> misses = detail::simulateCacheMisses(indices, vertexCount, cacheSize);
+    unsigned int transformed = std::accumulate(misses.begin(), misses.end(), 0u);
+
+    /* only count vertices that are actually referenced */
+    std::vector<bool> referenced(vertexCount, false);
+    unsigned int uniqueVertices = 0;
+    for(unsigned int index : indices)
+    {
+        if(!referenced[index])
+        {
+            referenced[index] = true;
+            uniqueVertices++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(transformed) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(transformed) / static_cast<float>(uniqueVertices);
+    return stats;
+}
+
+void meshOptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+    unsigned int triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    detail::Adjacency adjacency = detail::buildAdjacency(indices, vertexCount);
+
+    std::vector<unsigned int> liveTriangles(vertexCount);
+    for(unsigned int v = 0; v < vertexCount; v++)
+    {
+        liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+    int fanning = detail::tipsifyNextVertex({}, liveTriangles, cacheTime, time, cacheSize, deadEnd, cursor, vertexCount);
+
+    while(fanning >= 0)
+    {
+        candidates.clear();
+
+        /* emit all remaining triangles around the fanning vertex */
+        for(unsigned int i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++)
+        {
+            unsigned int t = adjacency.triangles[i];
+            if(emitted[t])
+            {
+                continue;
+            }
+
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+
+                if(time - cacheTime[v] > cacheSize)
+                {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        fanning = detail::tipsifyNextVertex(candidates, liveTriangles, cacheTime, time, cacheSize, deadEnd, cursor, vertexCount);
+    }
+
+    indices.swap(result);
+}
+
+void meshOptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vector3D>& positions, float threshold, unsigned int cacheSize)
+{
+    unsigned int triangleCount = indices.size() / 3;
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    /* split into clusters wherever the running ACMR of the current cluster is already close to the global one, so that
+     * reordering the clusters costs at most the given cache efficiency (Sander et al. 2007) */
+    std::vector<unsigned int> misses = detail::simulateCacheMisses(indices, positions.size(), cacheSize);
+    float targetAcmr = threshold * meshAnalyzeVertexCache(indices, positions.size(), cacheSize).acmr;
+
+    std::vector<unsigned int> clusterStarts = {0};
+    unsigned int clusterMisses = 0;
+    for(unsigned int t = 0; t < triangleCount; t++)
+    {
+        unsigned int clusterSize = t - clusterStarts.back();
+        if(clusterSize > 0 && misses[t] == 3 && static_cast<float>(clusterMisses) / clusterSize <= targetAcmr)
+        {
+            /* a triangle with three misses starts a fresh cache window anyway */
+            clusterStarts.push_back(t);
+            clusterMisses = 0;
+        }
+        clusterMisses += misses[t];
+    }
+    clusterStarts.push_back(triangleCount);
+
+    Vector3D meshCenter;
+    float meshArea = 0.0f;
+    for(unsigned int t = 0; t < triangleCount; t++)
+    {
+        const Vector3D& a = positions[indices[t * 3 + 0]];
+        const Vector3D& b = positions[indices[t * 3 + 1]];
+        const Vector3D& c = positions[indices[t * 3 + 2]];
+        float area = length(detail::triangleNormal(a, b, c));
+        meshCenter += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    meshCenter = meshArea > 0.0f ? meshCenter / meshArea : Vector3D();
+
+    /* clusters facing away from the mesh center occlude the rest and are drawn first */
+    std::vector<float> sortKeys(clusterStarts.size() - 1);
+    for(unsigned int c = 0; c + 1 < clusterStarts.size(); c++)
+    {
+        Vector3D center;
+        Vector3D normal;
+        float area = 0.0f;
+        for(unsigned int t = clusterStarts[c]; t < clusterStarts[c + 1]; t++)
+        {
+            const Vector3D& p0 = positions[indices[t * 3 + 0]];
+            const Vector3D& p1 = positions[indices[t * 3 + 1]];
+            const Vector3D& p2 = positions[indices[t * 3 + 2]];
+            Vector3D n = detail::triangleNormal(p0, p1, p2);
+            float triangleArea = length(n);
+            center += (p0 + p1 + p2) * (triangleArea / 3.0f);
+            normal += n;
+            area += triangleArea;
+        }
+        center = area > 0.0f ? center / area : center;
+        float normalLength = length(normal);
+        normal = normalLength > 0.0f ? normal / normalLength : normal;
+
+        sortKeys[c] = dot(center - meshCenter, normal);
+    }
+
+    std::vector<unsigned int> order(sortKeys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(unsigned int c : order)
+    {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+    }
+
+    indices.swap(result);
+}
+
+std::vector<unsigned int> meshOptimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> remap(vertexCount, unassigned);
+    unsigned int next = 0;
+
+    for(unsigned int& index : indices)
+    {
+        if(remap[index] == unassigned)
+        {
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+
+    for(unsigned int& target : remap)
+    {
+        if(target == unassigned)
+        {
+            target = next++;
+        }
+    }
+
+    return remap;
+}
+
+namespace detail
+{
+    template<typename T>
+    void optimize(std::vector<T>& vertices, std::vector<unsigned int>& indices, const std::vector<Vector3D>& positions, const std::string& name)
+    {
+        VertexCacheStats before = meshAnalyzeVertexCache(indices, vertices.size());
+
+        meshOptimizeVertexCache(indices, vertices.size());
+        meshOptimizeOverdraw(indices, positions);
+        meshRemapVertices(vertices, meshOptimizeVertexFetch(indices, vertices.size()));
+
+        VertexCacheStats after = meshAnalyzeVertexCache(indices, vertices.size());
+
+        std::cout << "[MeshOpt] " << name << " (" << indices.size() / 3 << " triangles): ACMR " << before.acmr << " -> "
+                  << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+    }
+}
+
+void meshOptimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::string& name)
+{
+    std::vector<Vector3D> positions(vertices.size());
+    for(unsigned int i = 0; i < vertices.size(); i++)
+    {
+        positions[i] = vertices[i].pos;
+    }
+    detail::optimize(vertices, indices, positions, name);
+}
+
+void meshOptimize(std::vector<Vector3D>& positions, std::vector<unsigned int>& indices, const std::string& name)
+{
+    std::vector<Vector3D> reference = positions;
+    detail::optimize(positions, indices, reference, name);
+}
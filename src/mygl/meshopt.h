@@ -0,0 +1,103 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <string>
+#include <vector>
+
+/* size of the simulated post-transform cache, matches the FIFO size of most desktop GPUs */
+#define MESHOPT_CACHE_SIZE 16
+
+struct VertexCacheStats
+{
+    float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle (0.5 optimal, 3.0 worst)
+    float atvr = 0.0f; // average transform to vertex ratio: transformed vertices per unique vertex (1.0 optimal)
+};
+
+/**
+ * @brief Simulates a FIFO post-transform vertex cache for an index buffer and reports how often vertices get transformed.
+ *
+ * @param indices Triangle list.
+ * @param vertexCount Number of vertices referenced by the index buffer.
+ * @param cacheSize Number of entries of the simulated cache.
+ *
+ * @return ACMR and ATVR of the index buffer.
+ */
+VertexCacheStats meshAnalyzeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = MESHOPT_CACHE_SIZE);
+
+/**
+ * @brief Reorders triangles to improve post-transform cache hits (Tipsify, Sander et al. 2007). The winding of each
+ * triangle is preserved.
+ *
+ * @param indices Triangle list that gets reordered in place.
+ * @param vertexCount Number of vertices referenced by the index buffer.
+ * @param cacheSize Number of entries of the targeted cache.
+ */
+void meshOptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = MESHOPT_CACHE_SIZE);
+
+/**
+ * @brief Splits a cache optimized triangle list into clusters and sorts these so that outward facing clusters are drawn
+ * first, which reduces overdraw from most view directions. Clusters are only split where the cache efficiency stays
+ * within the given threshold of the input order.
+ *
+ * @param indices Cache optimized triangle list that gets reordered in place.
+ * @param positions Vertex positions.
+ * @param threshold Allowed ACMR degradation (e.g. 1.05 allows 5% more vertex transforms).
+ * @param cacheSize Number of entries of the targeted cache.
+ */
+void meshOptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vector3D>& positions, float threshold = 1.05f, unsigned int cacheSize = MESHOPT_CACHE_SIZE);
+
+/**
+ * @brief Renumbers vertices in the order they are first referenced by the index buffer so that vertex fetches walk the
+ * vertex buffer linearly. Unreferenced vertices are moved to the end.
+ *
+ * @param indices Triangle list whose indices get rewritten in place.
+ * @param vertexCount Number of vertices in the vertex buffer.
+ *
+ * @return Remap table (old index -> new index) that has to be applied to the vertex data (see meshRemapVertices).
+ */
+std::vector<unsigned int> meshOptimizeVertexFetch(std::vector<unsigned int>& indices, unsigned int vertexCount);
+
+/**
+ * @brief Applies a remap table created by meshOptimizeVertexFetch to vertex data.
+ *
+ * @param vertices Vertex data that gets reordered in place.
+ * @param remap Remap table (old index -> new index).
+ */
+template<typename T>
+void meshRemapVertices(std::vector<T>& vertices, const std::vector<unsigned int>& remap)
+{
+    std::vector<T> reordered(vertices.size());
+    for(unsigned int i = 0; i < vertices.size(); i++)
+    {
+        reordered[remap[i]] = vertices[i];
+    }
+    vertices.swap(reordered);
+}
+
+/**
+ * @brief Runs all optimization passes (vertex cache, overdraw, vertex fetch) on a mesh and prints the ACMR/ATVR before
+ * and after. Meant to be run once at load or cook time.
+ *
+ * @param vertices Vertex data that gets reordered in place.
+ * @param indices Triangle list that gets reordered in place.
+ * @param name Name of the mesh used in the printed report.
+ *
+ * usage:
+ *
+ *   std::vector<Vertex> vertices = cube::vertices;
+ *   std::vector<unsigned int> indices = cube::indices;
+ *   meshOptimize(vertices, indices, "cube");
+ *   Mesh myMesh = meshCreate(vertices, indices, GL_STATIC_DRAW, GL_STATIC_DRAW);
+ */
+void meshOptimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, const std::string& name);
+
+/**
+ * @brief Runs all optimization passes (vertex cache, overdraw, vertex fetch) on a position only mesh and prints the
+ * ACMR/ATVR before and after.
+ *
+ * @param positions Vertex positions that get reordered in place.
+ * @param indices Triangle list that gets reordered in place.
+ * @param name Name of the mesh used in the printed report.
+ */
+void meshOptimize(std::vector<Vector3D>& positions, std::vector<unsigned int>& indices, const std::string& name);
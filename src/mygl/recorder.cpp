@@ -0,0 +1,476 @@
+#include "recorder.h"
+#include "glstate.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RECORDER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+#define RECORDER_RING 4u     // frames read back but not yet converted
+#define RECORDER_FRAMES 8u   // converted frames waiting for the output
+
+namespace detail
+{
+    enum eRecordState { RecordFree, RecordReading, RecordConverting };
+
+    /* one pixel pack buffer of the readback ring */
+    struct RecordSlot
+    {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        eRecordState state = RecordFree;
+        const unsigned char* pixels = nullptr;  // mapping read by the converter
+        bool converted = false;                 // guarded by Recorder::mutex
+    };
+
+    struct Recorder
+    {
+        FILE* output = nullptr;
+        bool pipe = false;
+        int width = 0;
+        int height = 0;
+
+        RecordSlot slots[RECORDER_RING];
+        unsigned int next = 0;
+
+        /* converter and writer thread, the frame buffers bound how far the output may fall behind */
+        std::thread converter;
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<RecordSlot*> convertJobs;
+        std::deque<std::vector<uint8_t>*> writeJobs;
+        std::deque<std::vector<uint8_t>*> freeFrames;
+        std::vector<uint8_t> frames[RECORDER_FRAMES];
+        bool stopConverter = false;
+        bool stopWriter = false;
+        bool writeFailed = false;
+
+        RecordingStats stats;
+    };
+
+    Recorder& recorder()
+    {
+        static Recorder state;
+        return state;
+    }
+
+    uint8_t clampByte(int value)
+    {
+        return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    /* BT.601 full range (JPEG) in 8 bit fixed point, SIMD and scalar paths produce identical results */
+    uint8_t lumaOf(const uint8_t* p)
+    {
+        return clampByte((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+
+    void chromaOf(const uint8_t* p, uint8_t& u, uint8_t& v)
+    {
+        u = clampByte(((-43 * p[0] - 85 * p[1] + 128 * p[2] + 128) >> 8) + 128);
+        v = clampByte(((128 * p[0] - 107 * p[1] - 21 * p[2] + 128) >> 8) + 128);
+    }
+
+    /* average of a 2x2 block with the rounding of _mm_avg_epu8 */
+    void average2x2(const uint8_t* row0, const uint8_t* row1, uint8_t* out)
+    {
+        for(int c = 0; c < 4; c++)
+        {
+            int left = (row0[c] + row1[c] + 1) >> 1;
+            int right = (row0[c + 4] + row1[c + 4] + 1) >> 1;
+            out[c] = static_cast<uint8_t>((left + right + 1) >> 1);
+        }
+    }
+
+#ifdef RECORDER_SSE2
+    /* dot product of the rgb channels of 4 RGBA pixels with 16 bit coefficients, one int32 per pixel */
+    inline __m128i dot4(__m128i pixels, __m128i coefficients)
+    {
+        __m128i zero = _mm_setzero_si128();
+        __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients));
+        __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients));
+        __m128i rg = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i ba = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_add_epi32(rg, ba);
+    }
+
+    /* 8 bytes of (dot + 128) >> 8 + offset for 8 pixels */
+    inline __m128i fixedToBytes(__m128i a, __m128i b, int offset)
+    {
+        __m128i round = _mm_set1_epi32(128 + (offset << 8));
+        a = _mm_srai_epi32(_mm_add_epi32(a, round), 8);
+        b = _mm_srai_epi32(_mm_add_epi32(b, round), 8);
+        __m128i words = _mm_packs_epi32(a, b);
+        return _mm_packus_epi16(words, words);
+    }
+
+    /* 2x2 averages of 8 pixels in two rows, the 4 results are packed into the low 16 bytes */
+    inline __m128i average8(const uint8_t* row0, const uint8_t* row1)
+    {
+        __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) row0), _mm_loadu_si128((const __m128i*) row1));
+        __m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*) (row0 + 16)), _mm_loadu_si128((const __m128i*) (row1 + 16)));
+        a = _mm_avg_epu8(a, _mm_srli_si128(a, 4));
+        b = _mm_avg_epu8(b, _mm_srli_si128(b, 4));
+        return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+#endif
+
+    /* converts two image rows to luma and one row of chroma */
+    void convertRowPair(const uint8_t* row0, const uint8_t* row1, int width, uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+    {
+        int x = 0;
+#ifdef RECORDER_SSE2
+        const __m128i lumaCoefficients = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+        const __m128i uCoefficients = _mm_setr_epi16(-43, -85, 128, 0, -43, -85, 128, 0);
+        const __m128i vCoefficients = _mm_setr_epi16(128, -107, -21, 0, 128, -107, -21, 0);
+        for(; x + 8 <= width; x += 8)
+        {
+            const uint8_t* p0 = row0 + x * 4;
+            const uint8_t* p1 = row1 + x * 4;
+
+            __m128i luma0 = fixedToBytes(dot4(_mm_loadu_si128((const __m128i*) p0), lumaCoefficients),
+                                         dot4(_mm_loadu_si128((const __m128i*) (p0 + 16)), lumaCoefficients), 0);
+            __m128i luma1 = fixedToBytes(dot4(_mm_loadu_si128((const __m128i*) p1), lumaCoefficients),
+                                         dot4(_mm_loadu_si128((const __m128i*) (p1 + 16)), lumaCoefficients), 0);
+            _mm_storel_epi64((__m128i*) (y0 + x), luma0);
+            _mm_storel_epi64((__m128i*) (y1 + x), luma1);
+
+            __m128i average = average8(p0, p1);
+            __m128i chroma = fixedToBytes(dot4(average, uCoefficients), dot4(average, vCoefficients), 128);
+            int32_t uv[2];
+            _mm_storel_epi64((__m128i*) uv, chroma);
+            std::memcpy(u + x / 2, &uv[0], 4);
+            std::memcpy(v + x / 2, &uv[1], 4);
+        }
+#endif
+        for(; x + 2 <= width; x += 2)
+        {
+            const uint8_t* p0 = row0 + x * 4;
+            const uint8_t* p1 = row1 + x * 4;
+            y0[x] = lumaOf(p0);
+            y0[x + 1] = lumaOf(p0 + 4);
+            y1[x] = lumaOf(p1);
+            y1[x + 1] = lumaOf(p1 + 4);
+
+            uint8_t average[4];
+            average2x2(p0, p1, average);
+            chromaOf(average, u[x / 2], v[x / 2]);
+        }
+    }
+
+    /* OpenGL rows start at the bottom, the image is flipped while converting */
+    void convertFrame(const uint8_t* pixels, int width, int height, uint8_t* frame)
+    {
+        size_t stride = static_cast<size_t>(width) * 4;
+        uint8_t* yPlane = frame;
+        uint8_t* uPlane = yPlane + static_cast<size_t>(width) * height;
+        uint8_t* vPlane = uPlane + static_cast<size_t>(width / 2) * (height / 2);
+
+        for(int y = 0; y < height; y += 2)
+        {
+            const uint8_t* row0 = pixels + (height - 1 - y) * stride;
+            const uint8_t* row1 = row0 - stride;
+            size_t chroma = static_cast<size_t>(y / 2) * (width / 2);
+            convertRowPair(row0, row1, width, yPlane + y * width, yPlane + (y + 1) * width, uPlane + chroma, vPlane + chroma);
+        }
+    }
+
+    void convertFrames()
+    {
+        Recorder& state = recorder();
+        while(true)
+        {
+            RecordSlot* slot;
+            std::vector<uint8_t>* frame;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.wake.wait(lock, [&state]()
+                {
+                    return (state.stopConverter && state.convertJobs.empty()) ||
+                           (!state.convertJobs.empty() && !state.freeFrames.empty());
+                });
+                if(state.convertJobs.empty())
+                {
+                    return;
+                }
+                slot = state.convertJobs.front();
+                state.convertJobs.pop_front();
+                frame = state.freeFrames.front();
+                state.freeFrames.pop_front();
+            }
+
+            convertFrame(slot->pixels, state.width, state.height, frame->data());
+
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                slot->converted = true;
+                state.writeJobs.push_back(frame);
+            }
+            state.wake.notify_all();
+        }
+    }
+
+    void writeFrames()
+    {
+        Recorder& state = recorder();
+        while(true)
+        {
+            std::vector<uint8_t>* frame;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.wake.wait(lock, [&state]() { return state.stopWriter || !state.writeJobs.empty(); });
+                if(state.writeJobs.empty())
+                {
+                    return;
+                }
+                frame = state.writeJobs.front();
+                state.writeJobs.pop_front();
+            }
+
+            bool written = std::fputs("FRAME\n", state.output) >= 0 &&
+                           std::fwrite(frame->data(), 1, frame->size(), state.output) == frame->size();
+
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if(!written && !state.writeFailed)
+                {
+                    std::cerr << "[Recorder] Writing the recording failed" << std::endl;
+                    state.writeFailed = true;
+                }
+                state.stats.frames += written;
+                state.freeFrames.push_back(frame);
+            }
+            state.wake.notify_all();
+        }
+    }
+
+    /* maps a finished readback and queues it for conversion */
+    void convertSlot(RecordSlot& slot)
+    {
+        Recorder& state = recorder();
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        GLsizeiptr size = static_cast<GLsizeiptr>(state.width) * state.height * 4;
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        slot.pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if(!slot.pixels)
+        {
+            std::cerr << "[Recorder] Couldn't map frame readback" << std::endl;
+            slot.state = RecordFree;
+            return;
+        }
+
+        slot.state = RecordConverting;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            slot.converted = false;
+            state.convertJobs.push_back(&slot);
+        }
+        state.wake.notify_all();
+    }
+
+    void releaseSlot(RecordSlot& slot)
+    {
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.pixels = nullptr;
+        slot.state = RecordFree;
+    }
+
+    /* advances a slot as far as possible, waits for the GPU and the converter if block is set */
+    void updateSlot(RecordSlot& slot, bool block)
+    {
+        Recorder& state = recorder();
+        if(slot.state == RecordReading)
+        {
+            GLuint64 timeout = block ? GL_TIMEOUT_IGNORED : 0;
+            if(glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout) == GL_TIMEOUT_EXPIRED)
+            {
+                return;
+            }
+            convertSlot(slot);
+        }
+        if(slot.state == RecordConverting)
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            if(block)
+            {
+                state.wake.wait(lock, [&slot]() { return slot.converted; });
+            }
+            if(!slot.converted)
+            {
+                return;
+            }
+            lock.unlock();
+            releaseSlot(slot);
+        }
+    }
+}
+
+bool recordingStart(const std::string &target, unsigned int fps)
+{
+    detail::Recorder& state = detail::recorder();
+    if(state.output)
+    {
+        recordingStop();
+    }
+
+    state.pipe = !target.empty() && target[0] == '|';
+    state.output = state.pipe ? popen(target.c_str() + 1, "w") : std::fopen(target.c_str(), "wb");
+    if(!state.output)
+    {
+        std::cerr << "[Recorder] Couldn't open " << target << std::endl;
+        return false;
+    }
+
+    /* 4:2:0 needs even dimensions */
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    state.width = viewport[2] & ~1;
+    state.height = viewport[3] & ~1;
+    std::fprintf(state.output, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", state.width, state.height, fps);
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(state.width) * state.height * 4;
+    for(detail::RecordSlot& slot : state.slots)
+    {
+        glGenBuffers(1, &slot.pbo);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    for(std::vector<uint8_t>& frame : state.frames)
+    {
+        frame.resize(static_cast<size_t>(state.width) * state.height * 3 / 2);
+        state.freeFrames.push_back(&frame);
+    }
+
+    state.stats = RecordingStats();
+    state.stats.active = true;
+    state.next = 0;
+    state.writeFailed = false;
+    state.stopConverter = false;
+    state.stopWriter = false;
+    state.converter = std::thread(detail::convertFrames);
+    state.writer = std::thread(detail::writeFrames);
+
+    std::cout << "[Recorder] Recording " << state.width << "x" << state.height << " at " << fps << " fps to "
+              << target << std::endl;
+    return true;
+}
+
+void recordingStop()
+{
+    detail::Recorder& state = detail::recorder();
+    if(!state.output)
+    {
+        return;
+    }
+
+    /* oldest first, so the frames keep their order */
+    for(unsigned int i = 0; i < RECORDER_RING; i++)
+    {
+        detail::updateSlot(state.slots[(state.next + i) % RECORDER_RING], true);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stopConverter = true;
+    }
+    state.wake.notify_all();
+    state.converter.join();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stopWriter = true;
+    }
+    state.wake.notify_all();
+    state.writer.join();
+
+    state.pipe ? pclose(state.output) : std::fclose(state.output);
+    state.output = nullptr;
+
+    for(detail::RecordSlot& slot : state.slots)
+    {
+        glDeleteBuffers(1, &slot.pbo);
+        glStateForget(&slot.pbo, 1, nullptr, 0);
+        slot = detail::RecordSlot();
+    }
+    for(std::vector<uint8_t>& frame : state.frames)
+    {
+        std::vector<uint8_t>().swap(frame);
+    }
+    state.freeFrames.clear();
+    state.stats.active = false;
+
+    std::cout << "[Recorder] Stopped after " << state.stats.frames << " frames, " << state.stats.stalls
+              << " stalls (" << state.stats.stallSeconds * 1000.0 << " ms)" << std::endl;
+}
+
+bool recordingActive()
+{
+    return detail::recorder().output != nullptr;
+}
+
+void recordingFrameEnd()
+{
+    detail::Recorder& state = detail::recorder();
+    if(!state.output)
+    {
+        return;
+    }
+
+    /* pass finished readbacks on without waiting */
+    for(unsigned int i = 0; i < RECORDER_RING; i++)
+    {
+        detail::updateSlot(state.slots[(state.next + i) % RECORDER_RING], false);
+    }
+
+    /* the ring is full, wait for the oldest frame instead of dropping this one */
+    detail::RecordSlot& slot = state.slots[state.next];
+    if(slot.state != detail::RecordFree)
+    {
+        auto start = std::chrono::steady_clock::now();
+        detail::updateSlot(slot, true);
+        state.stats.stalls++;
+        state.stats.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* the back buffer (offscreen framebuffer in headless mode) holds the finished frame */
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadBuffer(windowHeadless() ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+    glReadPixels(0, 0, state.width, state.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.state = detail::RecordReading;
+    state.next = (state.next + 1) % RECORDER_RING;
+}
+
+RecordingStats recordingStats()
+{
+    detail::Recorder& state = detail::recorder();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "base.h"
+
+#include <string>
+
+struct RecordingStats
+{
+    bool active = false;
+    unsigned long frames = 0;     // frames written
+    unsigned int stalls = 0;      // frames the render thread waited for the readback, conversion or output
+    double stallSeconds = 0.0;
+};
+
+/**
+ * @brief Starts recording every presented frame as YUV 4:2:0 video in the YUV4MPEG2 (Y4M) format. Frames are read back
+ * through a ring of pixel pack buffers, converted from RGB on a worker thread and written by a second one. If the output
+ * can't keep up the render thread waits instead of dropping frames. The size of the recording is fixed at the start.
+ *
+ * @param target Output file (e.g. "recording.y4m"), or "|command" to pipe the stream into an encoder.
+ * @param fps Frame rate written to the header.
+ *
+ * @return Whether the output could be opened.
+ *
+ * usage:
+ *
+ *   recordingStart("|ffmpeg -y -f yuv4mpegpipe -i - recording.mp4");
+ *   ... frames are captured by windowSwapBuffers(...)
+ *   recordingStop();
+ */
+bool recordingStart(const std::string& target, unsigned int fps = 60);
+
+/**
+ * @brief Writes all frames still in flight and closes the output.
+ */
+void recordingStop();
+
+/**
+ * @brief Returns whether a recording is running.
+ *
+ * @return True between recordingStart(...) and recordingStop().
+ */
+bool recordingActive();
+
+/**
+ * @brief Reads back the finished frame and passes completed readbacks on to the converter. Called by
+ * windowSwapBuffers(...) with the frame still in the back buffer, does nothing if no recording is running.
+ */
+void recordingFrameEnd();
+
+/**
+ * @brief Returns the statistics of the current or last recording.
+ *
+ * @return Recording counters.
+ */
+RecordingStats recordingStats();
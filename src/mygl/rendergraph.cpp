@@ -0,0 +1,437 @@
+#include "rendergraph.h"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#define RENDER_GRAPH_KEEP_FRAMES 120u   // frames a pool texture survives without being used
+
+namespace detail
+{
+    [[noreturn]] void graphError(const std::string& message)
+    {
+        std::cerr << "[RenderGraph] " << message << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[RenderGraph] " + message);
+    }
+
+    bool isDepthFormat(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32 ||
+               format == GL_DEPTH_COMPONENT32F || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    bool hasStencil(GLenum format)
+    {
+        return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    size_t bytesPerPixel(GLenum format)
+    {
+        switch(format)
+        {
+            case GL_R8: return 1;
+            case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16: return 2;
+            case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: return 8;
+            case GL_RGBA32F: return 16;
+            default: return 4;
+        }
+    }
+
+    size_t textureBytes(int width, int height, GLenum format)
+    {
+        return static_cast<size_t>(width) * height * bytesPerPixel(format);
+    }
+
+    GLuint createTexture(const GraphTexture& texture)
+    {
+        /* contents are never uploaded, only the matching format/type pair is needed */
+        GLenum format = GL_RGBA, type = GL_UNSIGNED_BYTE;
+        if(isDepthFormat(texture.format))
+        {
+            format = hasStencil(texture.format) ? GL_DEPTH_STENCIL : GL_DEPTH_COMPONENT;
+            type = texture.format == GL_DEPTH24_STENCIL8 ? GL_UNSIGNED_INT_24_8 :
+                   (texture.format == GL_DEPTH32F_STENCIL8 ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_FLOAT);
+        }
+
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexImage2D(GL_TEXTURE_2D, 0, texture.format, texture.width, texture.height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return id;
+    }
+
+    /* framebuffers are cached per attachment set, aliasing keeps that set small */
+    GLuint passFramebuffer(RenderGraph& graph, const GraphPass& pass)
+    {
+        std::vector<GLuint> attachments;
+        for(GraphResource resource : pass.writes)
+        {
+            attachments.push_back(graph.pool[graph.resources[resource].physical].id);
+        }
+
+        GLuint& fbo = graph.framebuffers[attachments];
+        if(fbo)
+        {
+            return fbo;
+        }
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        std::vector<GLenum> drawBuffers;
+        for(GraphResource resource : pass.writes)
+        {
+            const GraphResourceDesc& desc = graph.resources[resource];
+            GLuint texture = graph.pool[desc.physical].id;
+            if(isDepthFormat(desc.format))
+            {
+                GLenum attachment = hasStencil(desc.format) ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+            }
+            else
+            {
+                GLenum attachment = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(drawBuffers.size());
+                glFramebufferTexture2D(GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, texture, 0);
+                drawBuffers.push_back(attachment);
+            }
+        }
+        if(drawBuffers.empty())
+        {
+            glDrawBuffer(GL_NONE);
+        }
+        else
+        {
+            glDrawBuffers(static_cast<GLsizei>(drawBuffers.size()), drawBuffers.data());
+        }
+
+        if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            graphError("Incomplete framebuffer for pass " + pass.name);
+        }
+        return fbo;
+    }
+
+    void validatePass(const RenderGraph& graph, const GraphPass& pass)
+    {
+        for(GraphResource resource : pass.reads)
+        {
+            if(resource >= graph.resources.size())
+            {
+                graphError("Pass " + pass.name + " reads an undeclared resource");
+            }
+            if(graph.resources[resource].imported)
+            {
+                graphError("Pass " + pass.name + " samples imported framebuffer " + graph.resources[resource].name);
+            }
+            if(std::find(pass.writes.begin(), pass.writes.end(), resource) != pass.writes.end())
+            {
+                graphError("Pass " + pass.name + " reads and writes " + graph.resources[resource].name);
+            }
+        }
+
+        bool imported = false;
+        for(GraphResource resource : pass.writes)
+        {
+            if(resource >= graph.resources.size())
+            {
+                graphError("Pass " + pass.name + " writes an undeclared resource");
+            }
+            const GraphResourceDesc& desc = graph.resources[resource];
+            const GraphResourceDesc& first = graph.resources[pass.writes.front()];
+            imported |= desc.imported;
+            if(desc.width != first.width || desc.height != first.height)
+            {
+                graphError("Pass " + pass.name + " writes resources of different sizes");
+            }
+        }
+        if(imported && pass.writes.size() > 1)
+        {
+            graphError("Pass " + pass.name + " writes an imported framebuffer together with other resources");
+        }
+    }
+}
+
+RenderGraph renderGraphCreate()
+{
+    return RenderGraph();
+}
+
+void renderGraphDelete(RenderGraph& graph)
+{
+    for(auto& entry : graph.framebuffers)
+    {
+        glDeleteFramebuffers(1, &entry.second);
+    }
+    for(const GraphTexture& texture : graph.pool)
+    {
+        if(texture.id)
+        {
+            glDeleteTextures(1, &texture.id);
+        }
+    }
+    graph = RenderGraph();
+}
+
+void renderGraphBegin(RenderGraph& graph)
+{
+    graph.resources.clear();
+    graph.passes.clear();
+    graph.order.clear();
+    graph.frame++;
+
+    /* release textures nobody asked for in a while, together with the framebuffers using them */
+    auto stale = [&graph](const GraphTexture& texture)
+    {
+        return graph.frame - texture.lastFrame > RENDER_GRAPH_KEEP_FRAMES;
+    };
+    for(const GraphTexture& texture : graph.pool)
+    {
+        if(!stale(texture) || !texture.id)
+        {
+            continue;
+        }
+        for(auto entry = graph.framebuffers.begin(); entry != graph.framebuffers.end();)
+        {
+            const std::vector<GLuint>& attachments = entry->first;
+            if(std::find(attachments.begin(), attachments.end(), texture.id) != attachments.end())
+            {
+                glDeleteFramebuffers(1, &entry->second);
+                entry = graph.framebuffers.erase(entry);
+            }
+            else
+            {
+                ++entry;
+            }
+        }
+        glDeleteTextures(1, &texture.id);
+    }
+    graph.pool.erase(std::remove_if(graph.pool.begin(), graph.pool.end(), stale), graph.pool.end());
+}
+
+GraphResource renderGraphImport(RenderGraph& graph, const std::string& name, GLuint fbo, int width, int height)
+{
+    GraphResourceDesc desc;
+    desc.name = name;
+    desc.width = width;
+    desc.height = height;
+    desc.imported = true;
+    desc.importedFbo = fbo;
+    graph.resources.push_back(desc);
+    return static_cast<GraphResource>(graph.resources.size() - 1);
+}
+
+GraphResource renderGraphCreateTexture(RenderGraph& graph, const std::string& name, int width, int height, GLenum format)
+{
+    GraphResourceDesc desc;
+    desc.name = name;
+    desc.width = width;
+    desc.height = height;
+    desc.format = format;
+    graph.resources.push_back(desc);
+    return static_cast<GraphResource>(graph.resources.size() - 1);
+}
+
+void renderGraphAddPass(RenderGraph& graph, const std::string& name, const std::vector<GraphResource>& reads,
+                        const std::vector<GraphResource>& writes, GraphPassExecute execute, void* user)
+{
+    GraphPass pass;
+    pass.name = name;
+    pass.reads = reads;
+    pass.writes = writes;
+    pass.execute = execute;
+    pass.user = user;
+    graph.passes.push_back(pass);
+}
+
+void renderGraphCompile(RenderGraph& graph)
+{
+    RenderGraphStats stats;
+    stats.passes = static_cast<unsigned int>(graph.passes.size());
+
+    /* culling: walk backwards from the imported resources, a pass survives if a later surviving pass (or the outside)
+     * needs something it writes, its reads are then needed as well */
+    std::vector<bool> needed(graph.resources.size());
+    for(size_t r = 0; r < graph.resources.size(); r++)
+    {
+        needed[r] = graph.resources[r].imported;
+    }
+    for(size_t p = graph.passes.size(); p-- > 0;)
+    {
+        GraphPass& pass = graph.passes[p];
+        detail::validatePass(graph, pass);
+
+        pass.culled = std::none_of(pass.writes.begin(), pass.writes.end(), [&needed](GraphResource r) { return needed[r]; });
+        pass.before.clear();
+        pass.after.clear();
+        if(pass.culled)
+        {
+            stats.culled++;
+            continue;
+        }
+        for(GraphResource resource : pass.reads)
+        {
+            needed[resource] = true;
+        }
+    }
+
+    /* declaration order is a valid order, surviving passes keep it */
+    graph.order.clear();
+    for(unsigned int p = 0; p < graph.passes.size(); p++)
+    {
+        if(!graph.passes[p].culled)
+        {
+            graph.order.push_back(p);
+        }
+    }
+
+    /* lifetimes in execution order */
+    for(GraphResourceDesc& desc : graph.resources)
+    {
+        desc.firstUse = -1;
+        desc.lastUse = -1;
+        desc.physical = -1;
+    }
+    for(int position = 0; position < static_cast<int>(graph.order.size()); position++)
+    {
+        GraphPass& pass = graph.passes[graph.order[position]];
+        for(GraphResource resource : pass.reads)
+        {
+            GraphResourceDesc& desc = graph.resources[resource];
+            if(desc.firstUse < 0)
+            {
+                detail::graphError("Pass " + pass.name + " reads " + desc.name + " before any pass writes it");
+            }
+            desc.lastUse = position;
+            pass.before.push_back({resource, BarrierSample});
+        }
+        for(GraphResource resource : pass.writes)
+        {
+            GraphResourceDesc& desc = graph.resources[resource];
+            desc.firstUse = desc.firstUse < 0 ? position : desc.firstUse;
+            desc.lastUse = position;
+        }
+    }
+
+    /* aliasing: in order of first use, take a pool texture of the same size and format that is free by then */
+    std::vector<GraphResource> transients;
+    for(GraphResource r = 0; r < graph.resources.size(); r++)
+    {
+        if(!graph.resources[r].imported && graph.resources[r].firstUse >= 0)
+        {
+            transients.push_back(r);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [&graph](GraphResource a, GraphResource b)
+    {
+        return graph.resources[a].firstUse < graph.resources[b].firstUse;
+    });
+
+    for(GraphTexture& texture : graph.pool)
+    {
+        texture.busyUntil = -1;
+    }
+    std::vector<bool> used(graph.pool.size());
+    for(GraphResource resource : transients)
+    {
+        GraphResourceDesc& desc = graph.resources[resource];
+        for(size_t t = 0; t < graph.pool.size() && desc.physical < 0; t++)
+        {
+            const GraphTexture& texture = graph.pool[t];
+            if(texture.width == desc.width && texture.height == desc.height && texture.format == desc.format &&
+               texture.busyUntil < desc.firstUse)
+            {
+                desc.physical = static_cast<int>(t);
+            }
+        }
+        if(desc.physical < 0)
+        {
+            GraphTexture texture;
+            texture.width = desc.width;
+            texture.height = desc.height;
+            texture.format = desc.format;
+            graph.pool.push_back(texture);
+            used.push_back(false);
+            desc.physical = static_cast<int>(graph.pool.size() - 1);
+        }
+
+        GraphTexture& texture = graph.pool[desc.physical];
+        texture.busyUntil = desc.lastUse;
+        texture.lastFrame = graph.frame;
+        if(!used[desc.physical])
+        {
+            used[desc.physical] = true;
+            stats.textures++;
+            stats.textureBytes += detail::textureBytes(texture.width, texture.height, texture.format);
+        }
+        stats.transients++;
+        stats.transientBytes += detail::textureBytes(desc.width, desc.height, desc.format);
+
+        /* the next resource in the same texture overwrites it, nothing has to be kept after the last use */
+        graph.passes[graph.order[desc.lastUse]].after.push_back({resource, BarrierDiscard});
+    }
+
+    for(unsigned int p : graph.order)
+    {
+        stats.barriers += static_cast<unsigned int>(graph.passes[p].before.size() + graph.passes[p].after.size());
+    }
+    graph.lastFrame = stats;
+}
+
+RenderGraphStats renderGraphExecute(RenderGraph& graph)
+{
+    renderGraphCompile(graph);
+
+    for(GraphTexture& texture : graph.pool)
+    {
+        if(!texture.id && texture.lastFrame == graph.frame)
+        {
+            texture.id = detail::createTexture(texture);
+        }
+    }
+
+    for(unsigned int p : graph.order)
+    {
+        const GraphPass& pass = graph.passes[p];
+        if(pass.writes.empty())
+        {
+            continue;
+        }
+
+        const GraphResourceDesc& target = graph.resources[pass.writes.front()];
+        glBindFramebuffer(GL_FRAMEBUFFER, target.imported ? target.importedFbo : detail::passFramebuffer(graph, pass));
+        glViewport(0, 0, target.width, target.height);
+        glScissor(0, 0, target.width, target.height);
+
+        /* sampling what an earlier pass rendered needs no command in OpenGL, the driver orders render to texture
+         * before later reads once the texture isn't attached to the bound framebuffer anymore */
+        for(GLuint unit = 0; unit < pass.reads.size(); unit++)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, renderGraphTextureId(graph, pass.reads[unit]));
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        pass.execute(graph, pass, pass.user);
+
+        /* lets tiled and software renderers skip storing contents nobody reads again */
+        if(GLAD_GL_ARB_invalidate_subdata)
+        {
+            for(const GraphBarrier& barrier : pass.after)
+            {
+                glInvalidateTexImage(renderGraphTextureId(graph, barrier.resource), 0);
+            }
+        }
+    }
+    return graph.lastFrame;
+}
+
+GLuint renderGraphTextureId(const RenderGraph& graph, GraphResource resource)
+{
+    const GraphResourceDesc& desc = graph.resources[resource];
+    return desc.physical < 0 ? 0 : graph.pool[desc.physical].id;
+}
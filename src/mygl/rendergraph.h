@@ -0,0 +1,197 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/* handle of a virtual resource, valid for the frame it was declared in */
+typedef uint32_t GraphResource;
+
+struct RenderGraph;
+struct GraphPass;
+
+/* records the commands of a pass, the graph has bound its framebuffer and sampled textures (unit = read index) */
+typedef void (*GraphPassExecute)(RenderGraph& graph, const GraphPass& pass, void* user);
+
+/* virtual resource: a transient texture owned by the graph or an imported framebuffer (e.g. the window) */
+struct GraphResourceDesc
+{
+    std::string name;
+    int width = 0;
+    int height = 0;
+    GLenum format = 0;        // internal format of transient textures
+    bool imported = false;
+    GLuint importedFbo = 0;
+
+    /* compile results, positions in the execution order */
+    int firstUse = -1;
+    int lastUse = -1;
+    int physical = -1;        // pool texture backing a transient resource
+};
+
+/* synchronization the graph schedules around a pass */
+enum eGraphBarrier
+{
+    BarrierSample = 0,   // rendered by an earlier pass and sampled by this one
+    BarrierDiscard = 1,  // last use of a transient texture, its contents are dropped afterwards
+};
+
+struct GraphBarrier
+{
+    GraphResource resource;
+    eGraphBarrier kind;
+};
+
+struct GraphPass
+{
+    std::string name;
+    std::vector<GraphResource> reads;
+    std::vector<GraphResource> writes;
+    GraphPassExecute execute = nullptr;
+    void* user = nullptr;
+
+    /* compile results */
+    bool culled = false;
+    std::vector<GraphBarrier> before;
+    std::vector<GraphBarrier> after;
+};
+
+/* texture of the pool, shared by transient resources whose lifetimes don't overlap */
+struct GraphTexture
+{
+    GLuint id = 0;
+    int width = 0;
+    int height = 0;
+    GLenum format = 0;
+    int busyUntil = -1;       // last use of the resource currently assigned, while compiling
+    uint64_t lastFrame = 0;   // pool textures unused for a while are released
+};
+
+struct RenderGraphStats
+{
+    unsigned int passes = 0;
+    unsigned int culled = 0;
+    unsigned int transients = 0;
+    unsigned int textures = 0;          // pool textures used this frame
+    unsigned int barriers = 0;
+    size_t transientBytes = 0;          // memory of all transient resources without aliasing
+    size_t textureBytes = 0;            // memory of the pool textures used this frame
+};
+
+struct RenderGraph
+{
+    /* declared every frame */
+    std::vector<GraphResourceDesc> resources;
+    std::vector<GraphPass> passes;
+    std::vector<unsigned int> order;    // passes that survived culling, in execution order
+
+    /* kept across frames */
+    std::vector<GraphTexture> pool;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;  // attachments -> framebuffer object
+    uint64_t frame = 0;
+
+    RenderGraphStats lastFrame;
+};
+
+/**
+ * @brief Creates an empty render graph. Each frame passes are declared with the virtual resources they read and write,
+ * the graph then culls passes that don't contribute to an imported resource, assigns transient textures to a pool
+ * so resources with disjoint lifetimes share memory, schedules barriers and runs the remaining passes in order.
+ *
+ * @return Render graph.
+ *
+ * usage:
+ *
+ *   renderGraphBegin(graph);
+ *   GraphResource output = renderGraphImport(graph, "window", windowFramebuffer(), width, height);
+ *   GraphResource color = renderGraphCreateTexture(graph, "scene color", width, height, GL_RGBA16F);
+ *   renderGraphAddPass(graph, "scene", {}, {color}, drawScene);
+ *   renderGraphAddPass(graph, "tonemap", {color}, {output}, drawTonemap);
+ *   renderGraphExecute(graph);
+ */
+RenderGraph renderGraphCreate();
+
+/**
+ * @brief Deletes all pool textures and framebuffers.
+ *
+ * @param graph Render graph.
+ */
+void renderGraphDelete(RenderGraph& graph);
+
+/**
+ * @brief Starts declaring a new frame, resources and passes of the previous frame are dropped.
+ *
+ * @param graph Render graph.
+ */
+void renderGraphBegin(RenderGraph& graph);
+
+/**
+ * @brief Declares a framebuffer owned outside the graph. Passes writing it are never culled.
+ *
+ * @param graph Render graph.
+ * @param name Name for statistics and errors.
+ * @param fbo Framebuffer object, 0 for the default framebuffer.
+ * @param width Viewport width.
+ * @param height Viewport height.
+ *
+ * @return Virtual resource.
+ */
+GraphResource renderGraphImport(RenderGraph& graph, const std::string& name, GLuint fbo, int width, int height);
+
+/**
+ * @brief Declares a texture that only lives during the frame. Its contents are undefined before the first pass
+ * writing it, it's backed by a pool texture that other transient resources may use before and after.
+ *
+ * @param graph Render graph.
+ * @param name Name for statistics and errors.
+ * @param width Texture width.
+ * @param height Texture height.
+ * @param format Sized internal format, depth formats become the depth attachment of writing passes.
+ *
+ * @return Virtual resource.
+ */
+GraphResource renderGraphCreateTexture(RenderGraph& graph, const std::string& name, int width, int height, GLenum format);
+
+/**
+ * @brief Declares a pass. Passes have to be declared after the passes producing what they read. A pass either writes
+ * one imported resource or transient textures of the same size.
+ *
+ * @param graph Render graph.
+ * @param name Name for statistics and errors.
+ * @param reads Resources sampled by the pass, bound to texture unit 0, 1, ... in this order.
+ * @param writes Resources rendered to, color textures are attached in this order.
+ * @param execute Records the commands of the pass.
+ * @param user Passed to execute.
+ */
+void renderGraphAddPass(RenderGraph& graph, const std::string& name, const std::vector<GraphResource>& reads,
+                        const std::vector<GraphResource>& writes, GraphPassExecute execute, void* user = nullptr);
+
+/**
+ * @brief Culls passes, computes resource lifetimes, assigns pool textures and schedules barriers. Doesn't call
+ * OpenGL, done by renderGraphExecute(...).
+ *
+ * @param graph Render graph.
+ */
+void renderGraphCompile(RenderGraph& graph);
+
+/**
+ * @brief Compiles the graph, allocates missing pool textures and runs the remaining passes.
+ *
+ * @param graph Render graph.
+ *
+ * @return Statistics of the frame.
+ */
+RenderGraphStats renderGraphExecute(RenderGraph& graph);
+
+/**
+ * @brief Returns the texture backing a transient resource, valid while the frame executes.
+ *
+ * @param graph Render graph.
+ * @param resource Transient resource.
+ *
+ * @return OpenGL texture name.
+ */
+GLuint renderGraphTextureId(const RenderGraph& graph, GraphResource resource);
@@ -0,0 +1,242 @@
+#include "renderqueue.h"
+#include "glstate.h"
+#include "megabuffer.h"
+#include "mesh.h"
+#include "staticbatch.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+/* sort key layout from most to least significant bit */
+#define RENDERQUEUE_LAYER_BITS 2
+#define RENDERQUEUE_PROGRAM_BITS 12
+#define RENDERQUEUE_MATERIAL_BITS 12
+#define RENDERQUEUE_POOL_BITS 8
+#define RENDERQUEUE_DEPTH_BITS 30
+
+namespace detail
+{
+    uint32_t stableId(std::unordered_map<GLuint, uint32_t>& ids, GLuint key, unsigned int bits)
+    {
+        auto it = ids.emplace(key, uint32_t(ids.size())).first;
+        if(it->second >= (1u << bits))
+        {
+            std::cerr << "[RenderQueue] More than " << (1u << bits) << " programs in one queue" << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[RenderQueue] More than " + std::to_string(1u << bits) + " programs in one queue");
+        }
+        return it->second;
+    }
+
+    /* positive floats compare like their bit patterns, dropping low mantissa bits keeps the order */
+    uint64_t depthBits(float depth, bool backToFront)
+    {
+        uint32_t bits;
+        depth = std::max(depth, 0.0f);
+        std::memcpy(&bits, &depth, sizeof(bits));
+        uint64_t quantized = bits >> (32 - RENDERQUEUE_DEPTH_BITS);
+        return backToFront ? ((1ull << RENDERQUEUE_DEPTH_BITS) - 1 - quantized) : quantized;
+    }
+
+    uint64_t sortKey(RenderQueue& queue, const DrawPacket& packet)
+    {
+        uint32_t program = stableId(queue.programIds, packet.program, RENDERQUEUE_PROGRAM_BITS);
+
+        /* palette batches don't share geometry, they group under their own id */
+        const MegaBuffer* geometry = packet.kind == MeshDraw ? packet.mesh->pool : nullptr;
+        auto pool = queue.poolIds.emplace(geometry, uint32_t(queue.poolIds.size())).first;
+        uint64_t poolId = pool->second & ((1u << RENDERQUEUE_POOL_BITS) - 1);
+
+        uint64_t key = packet.layer & ((1u << RENDERQUEUE_LAYER_BITS) - 1);
+        key = (key << RENDERQUEUE_PROGRAM_BITS) | program;
+        key = (key << RENDERQUEUE_MATERIAL_BITS) | (packet.material & ((1u << RENDERQUEUE_MATERIAL_BITS) - 1));
+        key = (key << RENDERQUEUE_POOL_BITS) | poolId;
+        key = (key << RENDERQUEUE_DEPTH_BITS) | depthBits(packet.depth, packet.layer == Transparent);
+        return key;
+    }
+
+    /* LSD radix sort on 8 bit digits, digits that are equal in all keys are skipped */
+    void radixSort(std::vector<DrawSortItem>& items, std::vector<DrawSortItem>& scratch)
+    {
+        scratch.resize(items.size());
+        for(unsigned int shift = 0; shift < 64; shift += 8)
+        {
+            size_t histogram[256] = {};
+            for(const DrawSortItem& item : items)
+            {
+                histogram[(item.key >> shift) & 0xFF]++;
+            }
+            if(histogram[(items[0].key >> shift) & 0xFF] == items.size())
+            {
+                continue;
+            }
+
+            size_t offset = 0;
+            for(size_t& count : histogram)
+            {
+                size_t next = offset + count;
+                count = offset;
+                offset = next;
+            }
+            for(const DrawSortItem& item : items)
+            {
+                scratch[histogram[(item.key >> shift) & 0xFF]++] = item;
+            }
+            items.swap(scratch);
+        }
+    }
+}
+
+RenderQueue renderQueueCreate(unsigned int threadCount, size_t packetCapacity)
+{
+    RenderQueue queue;
+    queue.lists.resize(std::max(threadCount, 1u));
+    for(DrawPacketList& list : queue.lists)
+    {
+        list.arena = arenaCreate(packetCapacity * sizeof(DrawPacket));
+    }
+    return queue;
+}
+
+void renderQueueDelete(RenderQueue& queue)
+{
+    for(DrawPacketList& list : queue.lists)
+    {
+        arenaDelete(list.arena);
+    }
+    queue = RenderQueue();
+}
+
+void renderQueueSubmit(RenderQueue& queue, unsigned int thread, const DrawPacket& packet)
+{
+    DrawPacketList& list = queue.lists[thread];
+    if(list.count == list.capacity)
+    {
+        /* the old array stays in the arena until the next reset, which then grows to fit both */
+        size_t capacity = std::max<size_t>(list.capacity * 2, 64);
+        DrawPacket* packets = arenaAllocArray<DrawPacket>(list.arena, capacity);
+        if(list.count > 0)
+        {
+            std::memcpy(static_cast<void*>(packets), list.packets, list.count * sizeof(DrawPacket));
+        }
+        list.packets = packets;
+        list.capacity = capacity;
+    }
+    list.packets[list.count++] = packet;
+}
+
+RenderQueueStats renderQueueExecute(RenderQueue& queue, StreamBuffer& stream)
+{
+    RenderQueueStats stats;
+
+    /* programs replaced by hot reload leave stale ids behind, start over before the key runs out of bits */
+    if(queue.programIds.size() >= (1u << (RENDERQUEUE_PROGRAM_BITS - 1)))
+    {
+        queue.programIds.clear();
+    }
+    if(queue.poolIds.size() >= (1u << RENDERQUEUE_POOL_BITS))
+    {
+        queue.poolIds.clear();
+    }
+
+    /* merge */
+    queue.items.clear();
+    for(uint32_t l = 0; l < queue.lists.size(); l++)
+    {
+        const DrawPacketList& list = queue.lists[l];
+        for(uint32_t i = 0; i < list.count; i++)
+        {
+            const DrawPacket& packet = list.packets[i];
+            if(packet.kind == PaletteBatchDraw && (!packet.batch || !packet.palette))
+            {
+                std::cerr << "[RenderQueue] Palette batch packets need a batch and a palette" << std::endl;
+                std::cerr.flush();
+                throw std::runtime_error("[RenderQueue] Palette batch packets need a batch and a palette");
+            }
+            if(packet.kind == MeshDraw && (!packet.mesh || !packet.mesh->pool))
+            {
+                std::cerr << "[RenderQueue] Draw packets need a mesh allocated from a mega buffer" << std::endl;
+                std::cerr.flush();
+                throw std::runtime_error("[RenderQueue] Draw packets need a mesh allocated from a mega buffer");
+            }
+            queue.items.push_back({detail::sortKey(queue, packet), l, i});
+        }
+    }
+    stats.packets = queue.items.size();
+
+    /* sort and execute, a batch ends when program, material or mega buffer change or a palette batch is drawn */
+    if(!queue.items.empty())
+    {
+        detail::radixSort(queue.items, queue.scratch);
+
+        bool bound = false;
+        GLuint program = 0;
+        uint16_t material = 0;
+        MegaBuffer* pool = nullptr;
+        for(const DrawSortItem& item : queue.items)
+        {
+            /* the key only groups draws, compare the packets so truncated ids never merge different state */
+            const DrawPacket& packet = queue.lists[item.list].packets[item.index];
+            bool sameState = bound && packet.program == program && packet.material == material;
+            if(pool && (!sameState || packet.kind != MeshDraw || packet.mesh->pool != pool))
+            {
+                megaBufferDrawSubmit(*pool, stream);
+                stats.batches++;
+                pool = nullptr;
+            }
+
+            if(!sameState)
+            {
+                if(packet.program != program)
+                {
+                    glStateUseProgram(packet.program);
+                    program = packet.program;
+                    stats.programChanges++;
+                }
+                if(queue.bindMaterial)
+                {
+                    queue.bindMaterial(packet.program, packet.material);
+                }
+                material = packet.material;
+                bound = true;
+            }
+
+            if(packet.kind == PaletteBatchDraw)
+            {
+                if(queue.bindDraw)
+                {
+                    queue.bindDraw(packet.program, packet);
+                }
+                staticBatchDraw(*packet.batch, packet.palette, packet.paletteCount, stream);
+                stats.batches++;
+                continue;
+            }
+
+            if(!pool)
+            {
+                pool = packet.mesh->pool;
+                megaBufferDrawBegin(*pool);
+            }
+            megaBufferDrawAdd(*pool, *packet.mesh, packet.model, packet.lod);
+        }
+        if(pool)
+        {
+            megaBufferDrawSubmit(*pool, stream);
+            stats.batches++;
+        }
+    }
+
+    /* packets are only valid for one frame */
+    for(DrawPacketList& list : queue.lists)
+    {
+        arenaReset(list.arena);
+        list.packets = nullptr;
+        list.count = 0;
+        list.capacity = 0;
+    }
+
+    queue.lastFrame = stats;
+    return stats;
+}
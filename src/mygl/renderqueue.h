@@ -0,0 +1,132 @@
+#pragma once
+
+#include "base.h"
+#include "arena.h"
+#include "streambuffer.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct Mesh;
+struct MegaBuffer;
+struct StaticBatch;
+
+/* passes of a frame, drawn in this order */
+enum eRenderLayer { Opaque = 0, Transparent = 1 };
+
+/* what a packet draws */
+enum eDrawPacketKind { MeshDraw = 0, PaletteBatchDraw = 1 };
+
+/* everything needed to issue one draw, recorded by the scene and executed later */
+struct DrawPacket
+{
+    uint8_t kind = MeshDraw;
+    const Mesh* mesh = nullptr;          // MeshDraw: has to be allocated from a mega buffer
+    const StaticBatch* batch = nullptr;  // PaletteBatchDraw: drawn with its own glDrawElements
+    const Matrix4D* palette = nullptr;   // PaletteBatchDraw: has to stay valid until renderQueueExecute(...)
+    uint8_t paletteCount = 0;
+    GLuint program = 0;
+    uint16_t material = 0;        // draws with the same material share uniform state, see RenderQueue::bindMaterial
+    uint8_t layer = Opaque;
+    uint8_t lod = 0;
+    float depth = 0.0f;           // view distance, opaque draws are sorted front to back, transparent back to front
+    Matrix4D model;               // MeshDraw only, palette batches are placed by their palette
+    Vector4D params;              // per-draw values for RenderQueue::bindDraw, e.g. a fade factor
+};
+
+/* packets recorded by one thread, storage lives in the list's own arena */
+struct alignas(64) DrawPacketList
+{
+    LinearArena arena;
+    DrawPacket* packets = nullptr;
+    size_t count = 0;
+    size_t capacity = 0;
+};
+
+/* draw packet and its sort key */
+struct DrawSortItem
+{
+    uint64_t key;
+    uint32_t list;
+    uint32_t index;
+};
+
+struct RenderQueueStats
+{
+    unsigned int packets = 0;
+    unsigned int batches = 0;         // indirect multi draws and palette batch draws issued
+    unsigned int programChanges = 0;
+};
+
+struct RenderQueue
+{
+    /* one list per submitting thread, merged before sorting */
+    std::vector<DrawPacketList> lists;
+
+    /* sort buffers, reused every frame */
+    std::vector<DrawSortItem> items;
+    std::vector<DrawSortItem> scratch;
+
+    /* small stable ids of programs and mega buffers for the sort key, assigned on first use */
+    std::unordered_map<GLuint, uint32_t> programIds;
+    std::unordered_map<const MegaBuffer*, uint32_t> poolIds;
+
+    /* optional, called before the first draw of each material with the bound program */
+    void (*bindMaterial)(GLuint program, uint16_t material) = nullptr;
+
+    /* optional, called before each palette batch draw with the bound program */
+    void (*bindDraw)(GLuint program, const DrawPacket& packet) = nullptr;
+
+    RenderQueueStats lastFrame;
+};
+
+/**
+ * @brief Creates a render queue. Draws are recorded as packets, sorted by a 64 bit key (layer, program, material,
+ * geometry, depth) and executed with as few state changes as possible.
+ *
+ * @param threadCount Number of threads that record packets concurrently, each one uses its own list.
+ * @param packetCapacity Packets per list that fit into its arena before it has to grow.
+ *
+ * @return Initialized render queue.
+ *
+ * usage:
+ *
+ *   RenderQueue queue = renderQueueCreate(1);
+ *   DrawPacket packet; packet.mesh = &myMesh; packet.program = shader.id; packet.model = modelMatrix; ...
+ *   renderQueueSubmit(queue, 0, packet);
+ *   DrawPacket car; car.kind = PaletteBatchDraw; car.batch = &carBatch; car.palette = palette; car.paletteCount = n; ...
+ *   renderQueueSubmit(queue, 0, car);
+ *   renderQueueExecute(queue, stream);
+ */
+RenderQueue renderQueueCreate(unsigned int threadCount = 1, size_t packetCapacity = 256);
+
+/**
+ * @brief Frees the packet storage of a render queue.
+ *
+ * @param queue Render queue to delete.
+ */
+void renderQueueDelete(RenderQueue& queue);
+
+/**
+ * @brief Records a draw. Doesn't touch OpenGL, so any thread may record into its own list while other threads record
+ * into theirs.
+ *
+ * @param queue Render queue.
+ * @param thread Index of the list to record into (< threadCount).
+ * @param packet Draw to record.
+ */
+void renderQueueSubmit(RenderQueue& queue, unsigned int thread, const DrawPacket& packet);
+
+/**
+ * @brief Merges the lists of all threads, sorts the packets with a radix sort on their keys and draws them. Consecutive
+ * packets with the same program, material and mega buffer are drawn with one indirect multi draw, palette batches upload
+ * their palette and are drawn one by one within the same program and material runs. Has to be called on
+ * the thread owning the context after all threads finished recording, clears the queue for the next frame.
+ *
+ * @param queue Render queue.
+ * @param stream Stream buffer receiving the per-frame draw data.
+ *
+ * @return Statistics of the executed frame.
+ */
+RenderQueueStats renderQueueExecute(RenderQueue& queue, StreamBuffer& stream);
@@ -0,0 +1,231 @@
+#include "renderscale.h"
+#include "glstate.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#define RENDER_SCALE_STEP 0.05f          // scale granularity, also the step when raising
+#define RENDER_SCALE_MAX_DROP 0.25f      // largest single reduction
+#define RENDER_SCALE_HEADROOM 0.75f      // raise only while below this fraction of the budget
+#define RENDER_SCALE_OVER_FRAMES 3u      // frames above budget before lowering
+#define RENDER_SCALE_UNDER_FRAMES 30u    // frames below the headroom before raising
+#define RENDER_SCALE_SETTLE_FRAMES 8u    // frames ignored after a change, queries report a few frames late
+#define RENDER_SCALE_SMOOTHING 0.2f
+
+namespace detail
+{
+    bool allocateScaleTarget(RenderScale& scale)
+    {
+        if(!scale.fbo)
+        {
+            glGenFramebuffers(1, &scale.fbo);
+            glGenRenderbuffers(2, scale.renderbuffers);
+        }
+
+        /* full window size, scales below 1 only use the lower left part so changing the scale never reallocates */
+        glBindRenderbuffer(GL_RENDERBUFFER, scale.renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, scale.windowWidth, scale.windowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, scale.renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, scale.windowWidth, scale.windowHeight);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, scale.fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, scale.renderbuffers[0]);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, scale.renderbuffers[1]);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer());
+
+        scale.targetWidth = scale.windowWidth;
+        scale.targetHeight = scale.windowHeight;
+        return complete;
+    }
+
+    /* hysteresis: lower quickly towards the budget, raise one step after a long stretch of cheap frames */
+    void adjustScale(RenderScale& scale, float milliseconds)
+    {
+        if(scale.settleFrames > 0)
+        {
+            scale.settleFrames--;
+            return;
+        }
+
+        scale.gpuMs = scale.gpuMs == 0.0f ? milliseconds : scale.gpuMs + RENDER_SCALE_SMOOTHING * (milliseconds - scale.gpuMs);
+        scale.overFrames = scale.gpuMs > scale.budgetMs ? scale.overFrames + 1 : 0;
+        scale.underFrames = scale.gpuMs < scale.budgetMs * RENDER_SCALE_HEADROOM ? scale.underFrames + 1 : 0;
+
+        float next = scale.scale;
+        if(scale.overFrames >= RENDER_SCALE_OVER_FRAMES)
+        {
+            /* cost is roughly proportional to the pixel count, i.e. the square of the scale */
+            float fit = scale.scale * std::sqrt(scale.budgetMs / scale.gpuMs);
+            fit = std::max(fit, scale.scale - RENDER_SCALE_MAX_DROP);
+            next = std::min(std::floor(fit / RENDER_SCALE_STEP) * RENDER_SCALE_STEP, scale.scale - RENDER_SCALE_STEP);
+        }
+        else if(scale.underFrames >= RENDER_SCALE_UNDER_FRAMES)
+        {
+            next = scale.scale + RENDER_SCALE_STEP;
+        }
+
+        next = std::min(std::max(next, scale.minScale), 1.0f);
+        if(std::fabs(next - scale.scale) < 0.001f)
+        {
+            return;
+        }
+
+        scale.scale = next;
+        scale.gpuMs = 0.0f;
+        scale.overFrames = 0;
+        scale.underFrames = 0;
+        scale.settleFrames = RENDER_SCALE_SETTLE_FRAMES;
+        scale.changes++;
+    }
+
+    /* reads all finished timings without waiting, the oldest query is issued next */
+    void collectTimings(RenderScale& scale)
+    {
+        for(unsigned int i = 0; i < RENDER_SCALE_QUERIES; i++)
+        {
+            unsigned int index = (scale.nextQuery + i) % RENDER_SCALE_QUERIES;
+            if(!scale.queryIssued[index])
+            {
+                continue;
+            }
+
+            GLint available = 0;
+            glGetQueryObjectiv(scale.queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+            if(!available)
+            {
+                break;
+            }
+
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(scale.queries[index], GL_QUERY_RESULT, &nanoseconds);
+            scale.queryIssued[index] = false;
+            adjustScale(scale, static_cast<float>(nanoseconds) * 1e-6f);
+        }
+    }
+}
+
+RenderScale renderScaleCreate(int width, int height, float minScale, float budgetMs)
+{
+    if(minScale <= 0.0f || minScale > 1.0f || budgetMs <= 0.0f)
+    {
+        std::cerr << "[RenderScale] Invalid minimum scale " << minScale << " or budget " << budgetMs << " ms" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[RenderScale] Invalid settings");
+    }
+
+    RenderScale scale;
+    scale.minScale = minScale;
+    scale.budgetMs = budgetMs;
+    scale.windowWidth = width;
+    scale.windowHeight = height;
+
+    scale.timed = GLAD_GL_ARB_timer_query && minScale < 1.0f;
+    if(scale.timed)
+    {
+        glGenQueries(RENDER_SCALE_QUERIES, scale.queries);
+    }
+    else if(minScale < 1.0f)
+    {
+        std::cout << "[RenderScale] GL_ARB_timer_query is not supported, rendering at full resolution" << std::endl;
+    }
+    return scale;
+}
+
+void renderScaleDelete(RenderScale& scale)
+{
+    if(scale.fbo)
+    {
+        glDeleteFramebuffers(1, &scale.fbo);
+        glDeleteRenderbuffers(2, scale.renderbuffers);
+    }
+    if(scale.timed)
+    {
+        glDeleteQueries(RENDER_SCALE_QUERIES, scale.queries);
+    }
+    scale = RenderScale();
+}
+
+void renderScaleResize(RenderScale& scale, int width, int height)
+{
+    scale.windowWidth = width;
+    scale.windowHeight = height;
+}
+
+void renderScaleBegin(RenderScale& scale)
+{
+    if(scale.timed)
+    {
+        detail::collectTimings(scale);
+    }
+
+    bool scaled = scale.scale < 1.0f && scale.windowWidth > 0 && scale.windowHeight > 0;
+    if(scaled && (scale.targetWidth != scale.windowWidth || scale.targetHeight != scale.windowHeight))
+    {
+        if(!detail::allocateScaleTarget(scale))
+        {
+            std::cerr << "[RenderScale] Incomplete render target, rendering at full resolution" << std::endl;
+            scale.minScale = 1.0f;
+            scale.scale = 1.0f;
+            scaled = false;
+        }
+    }
+
+    scale.targetBound = scaled;
+    if(scaled)
+    {
+        /* scissor keeps clears inside the used part of the target */
+        glBindFramebuffer(GL_FRAMEBUFFER, scale.fbo);
+        glViewport(0, 0, renderScaleWidth(scale), renderScaleHeight(scale));
+        glScissor(0, 0, renderScaleWidth(scale), renderScaleHeight(scale));
+        glStateEnable(GL_SCISSOR_TEST, true);
+    }
+
+    /* a query still in flight from RENDER_SCALE_QUERIES frames ago skips timing this frame instead of waiting */
+    scale.queryActive = scale.timed && !scale.queryIssued[scale.nextQuery];
+    if(scale.queryActive)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, scale.queries[scale.nextQuery]);
+    }
+}
+
+void renderScaleEnd(RenderScale& scale)
+{
+    if(scale.targetBound)
+    {
+        glStateEnable(GL_SCISSOR_TEST, false);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, scale.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, windowFramebuffer());
+        glBlitFramebuffer(0, 0, renderScaleWidth(scale), renderScaleHeight(scale),
+                          0, 0, scale.windowWidth, scale.windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, windowFramebuffer());
+        glViewport(0, 0, scale.windowWidth, scale.windowHeight);
+        scale.targetBound = false;
+    }
+
+    if(scale.queryActive)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        scale.queryIssued[scale.nextQuery] = true;
+        scale.nextQuery = (scale.nextQuery + 1) % RENDER_SCALE_QUERIES;
+        scale.queryActive = false;
+    }
+}
+
+GLuint renderScaleFramebuffer(const RenderScale& scale)
+{
+    return scale.targetBound ? scale.fbo : windowFramebuffer();
+}
+
+int renderScaleWidth(const RenderScale& scale)
+{
+    return std::max(1, static_cast<int>(scale.windowWidth * scale.scale + 0.5f));
+}
+
+int renderScaleHeight(const RenderScale& scale)
+{
+    return std::max(1, static_cast<int>(scale.windowHeight * scale.scale + 0.5f));
+}
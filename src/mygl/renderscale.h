@@ -0,0 +1,121 @@
+#pragma once
+
+#include "base.h"
+
+#define RENDER_SCALE_QUERIES 4u
+
+/* internal render target whose resolution follows the measured GPU frame time */
+struct RenderScale
+{
+    /* settings */
+    float minScale = 0.5f;
+    float budgetMs = 16.7f;
+
+    /* current scale of both axes, 1 renders straight into the window framebuffer */
+    float scale = 1.0f;
+
+    /* window size and size of the allocated target, the target is reallocated lazily */
+    int windowWidth = 0;
+    int windowHeight = 0;
+    int targetWidth = 0;
+    int targetHeight = 0;
+    GLuint fbo = 0;
+    GLuint renderbuffers[2] = {0, 0};  // color, depth/stencil
+    bool targetBound = false;          // this frame renders into the target
+
+    /* GPU timing, unsupported without GL_ARB_timer_query (scale stays at 1) */
+    bool timed = false;
+    GLuint queries[RENDER_SCALE_QUERIES] = {};
+    bool queryIssued[RENDER_SCALE_QUERIES] = {};
+    unsigned int nextQuery = 0;
+    bool queryActive = false;
+
+    /* controller state */
+    float gpuMs = 0.0f;          // smoothed GPU time of the last frames
+    unsigned int settleFrames = 0;
+    unsigned int overFrames = 0;
+    unsigned int underFrames = 0;
+    unsigned int changes = 0;
+};
+
+/**
+ * @brief Creates the dynamic resolution state. The scene is rendered into a part of an internal target scaled between
+ * minScale and 100% of the window, chosen so the GPU time of the scene stays below the budget, and scaled up to the
+ * window with a bilinear blit. Lowering the scale reacts within a few frames, raising it needs a longer stretch of
+ * frames well below the budget so it doesn't oscillate.
+ *
+ * @param width Window framebuffer width.
+ * @param height Window framebuffer height.
+ * @param minScale Lowest scale of both axes (0, 1], 1 disables scaling.
+ * @param budgetMs GPU time per frame to stay below.
+ *
+ * @return Render scale state.
+ *
+ * usage:
+ *
+ *   RenderScale scale = renderScaleCreate(1280, 720, 0.5f, 16.7f);
+ *   renderScaleBegin(scale);
+ *   ... draw scene
+ *   renderScaleEnd(scale);
+ *   ... draw UI at native resolution
+ */
+RenderScale renderScaleCreate(int width, int height, float minScale, float budgetMs);
+
+/**
+ * @brief Releases the render target and timer queries.
+ *
+ * @param scale Render scale state.
+ */
+void renderScaleDelete(RenderScale& scale);
+
+/**
+ * @brief Sets a new window size. The target is only reallocated by the next renderScaleBegin(...) that needs it.
+ *
+ * @param scale Render scale state.
+ * @param width Window framebuffer width.
+ * @param height Window framebuffer height.
+ */
+void renderScaleResize(RenderScale& scale, int width, int height);
+
+/**
+ * @brief Collects finished GPU timings, adjusts the scale and binds the target with viewport and scissor set to the
+ * scaled size.
+ *
+ * @param scale Render scale state.
+ */
+void renderScaleBegin(RenderScale& scale);
+
+/**
+ * @brief Scales the rendered image up to the window framebuffer and restores the full window viewport.
+ *
+ * @param scale Render scale state.
+ */
+void renderScaleEnd(RenderScale& scale);
+
+/**
+ * @brief Returns the framebuffer the scene is rendered into this frame.
+ *
+ * @param scale Render scale state.
+ *
+ * @return The internal target between renderScaleBegin(...) and renderScaleEnd(...) if scaled, otherwise the window
+ * framebuffer.
+ */
+GLuint renderScaleFramebuffer(const RenderScale& scale);
+
+/**
+ * @brief Returns the width the scene is rendered at.
+ *
+ * @param scale Render scale state.
+ *
+ * @return Scaled width in pixels.
+ */
+int renderScaleWidth(const RenderScale& scale);
+
+/**
+ * @brief Returns the height the scene is rendered at.
+ *
+ * @param scale Render scale state.
+ *
+ * @return Scaled height in pixels.
+ */
+int renderScaleHeight(const RenderScale& scale);
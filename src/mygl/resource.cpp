@@ -0,0 +1,211 @@
+#include "resource.h"
+#include "glstate.h"
+
+#include <deque>
+#include <vector>
+
+#define RESOURCE_NAME_BATCH 32u
+#define RESOURCE_FALLBACK_FRAMES 3u
+
+namespace detail
+{
+    /* objects released during one frame */
+    struct ReleaseBatch
+    {
+        GLsync fence = nullptr;
+        unsigned int framesLeft = RESOURCE_FALLBACK_FRAMES;
+        std::vector<GLuint> names[ResourceTypeCount];
+    };
+
+    struct ResourceManager
+    {
+        std::vector<GLuint> freeBuffers;
+        std::vector<GLuint> freeVertexArrays;
+
+        ReleaseBatch current;
+        std::deque<ReleaseBatch> pending;
+
+        ResourceStats stats;
+        bool shutdown = false;
+    };
+
+    /* never destroyed, handles in globals may still release objects during static destruction */
+    ResourceManager& resources()
+    {
+        static ResourceManager* manager = new ResourceManager();
+        return *manager;
+    }
+
+    void deleteNames(eResourceType type, const std::vector<GLuint>& names)
+    {
+        if(names.empty())
+        {
+            return;
+        }
+
+        switch(type)
+        {
+            case ResourceBuffer:
+                glDeleteBuffers(names.size(), names.data());
+                glStateForget(names.data(), names.size(), nullptr, 0);
+                break;
+            case ResourceVertexArray:
+                glDeleteVertexArrays(names.size(), names.data());
+                glStateForget(nullptr, 0, names.data(), names.size());
+                break;
+            default:
+                for(GLuint name : names)
+                {
+                    glDeleteProgram(name);
+                }
+                break;
+        }
+    }
+
+    void deleteBatch(ReleaseBatch& batch)
+    {
+        ResourceManager& manager = resources();
+        for(unsigned int type = 0; type < ResourceTypeCount; type++)
+        {
+            deleteNames(eResourceType(type), batch.names[type]);
+            manager.stats.pendingDeletes -= batch.names[type].size();
+        }
+        if(batch.fence)
+        {
+            glDeleteSync(batch.fence);
+        }
+    }
+
+    /* glGenBuffers, glGenVertexArrays, ... */
+    typedef void (APIENTRYP GenNamesFn)(GLsizei count, GLuint* names);
+
+    GLuint takeName(std::vector<GLuint>& names, GenNamesFn generate)
+    {
+        if(names.empty())
+        {
+            names.resize(RESOURCE_NAME_BATCH);
+            generate(RESOURCE_NAME_BATCH, names.data());
+            resources().stats.pooledNames += RESOURCE_NAME_BATCH;
+        }
+
+        GLuint name = names.back();
+        names.pop_back();
+        resources().stats.pooledNames--;
+        return name;
+    }
+}
+
+void resourceRelease(eResourceType type, GLuint name, GLsizeiptr bytes)
+{
+    detail::ResourceManager& manager = detail::resources();
+    if(manager.shutdown)
+    {
+        return;
+    }
+
+    manager.current.names[type].push_back(name);
+    manager.stats.live[type]--;
+    manager.stats.bufferBytes -= bytes;
+    manager.stats.pendingDeletes++;
+}
+
+void resourceTrackBytes(GLsizeiptr bytes)
+{
+    detail::resources().stats.bufferBytes += bytes;
+}
+
+BufferHandle bufferCreate()
+{
+    detail::ResourceManager& manager = detail::resources();
+    manager.stats.live[ResourceBuffer]++;
+    return BufferHandle(detail::takeName(manager.freeBuffers, glGenBuffers));
+}
+
+void bufferData(BufferHandle& buffer, GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    glStateBindBuffer(target, buffer);
+    glBufferData(target, size, data, usage);
+    glCheckError();
+    buffer.setSize(size);
+}
+
+VertexArrayHandle vertexArrayCreate()
+{
+    detail::ResourceManager& manager = detail::resources();
+    manager.stats.live[ResourceVertexArray]++;
+    return VertexArrayHandle(detail::takeName(manager.freeVertexArrays, glGenVertexArrays));
+}
+
+ProgramHandle programCreate()
+{
+    GLuint name = glCreateProgram();
+    if(name)
+    {
+        detail::resources().stats.live[ResourceProgram]++;
+    }
+    return ProgramHandle(name);
+}
+
+void resourceFrameEnd()
+{
+    detail::ResourceManager& manager = detail::resources();
+
+    bool released = false;
+    for(const std::vector<GLuint>& names : manager.current.names)
+    {
+        released = released || !names.empty();
+    }
+    if(released)
+    {
+        manager.current.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        manager.pending.push_back(std::move(manager.current));
+        manager.current = detail::ReleaseBatch();
+    }
+
+    /* batches complete in submission order, stop at the first one still in flight */
+    while(!manager.pending.empty())
+    {
+        detail::ReleaseBatch& batch = manager.pending.front();
+        if(batch.fence)
+        {
+            GLenum result = glClientWaitSync(batch.fence, 0, 0);
+            if(result == GL_TIMEOUT_EXPIRED)
+            {
+                break;
+            }
+        }
+        else if(batch.framesLeft-- > 0)
+        {
+            break; // fence creation failed, wait a fixed number of frames instead
+        }
+
+        detail::deleteBatch(batch);
+        manager.pending.pop_front();
+    }
+}
+
+ResourceStats resourceStats()
+{
+    return detail::resources().stats;
+}
+
+void resourceShutdown()
+{
+    detail::ResourceManager& manager = detail::resources();
+
+    manager.pending.push_back(std::move(manager.current));
+    manager.current = detail::ReleaseBatch();
+    for(detail::ReleaseBatch& batch : manager.pending)
+    {
+        detail::deleteBatch(batch);
+    }
+    manager.pending.clear();
+
+    detail::deleteNames(ResourceBuffer, manager.freeBuffers);
+    detail::deleteNames(ResourceVertexArray, manager.freeVertexArrays);
+    manager.freeBuffers.clear();
+    manager.freeVertexArrays.clear();
+    manager.stats.pooledNames = 0;
+
+    manager.shutdown = true;
+}
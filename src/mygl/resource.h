@@ -0,0 +1,151 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+
+enum eResourceType { ResourceBuffer = 0, ResourceVertexArray = 1, ResourceProgram = 2, ResourceTypeCount = 3 };
+
+struct ResourceStats
+{
+    unsigned int live[ResourceTypeCount] = {};  // handles currently owning an object
+    uint64_t bufferBytes = 0;                   // storage of all live buffers
+    unsigned int pendingDeletes = 0;            // released objects waiting for their fence
+    unsigned int pooledNames = 0;               // pre-generated names not handed out yet
+};
+
+/**
+ * @brief Queues an OpenGL object for deletion once the GPU has finished the current frame (see resourceFrameEnd()).
+ * Called by the handle destructors, objects released after resourceShutdown() are ignored.
+ *
+ * @param type Object type.
+ * @param name OpenGL name of the object.
+ * @param bytes Storage tracked for the object.
+ */
+void resourceRelease(eResourceType type, GLuint name, GLsizeiptr bytes);
+
+/**
+ * @brief Adds to the tracked storage size of all live buffers.
+ *
+ * @param bytes Number of bytes, negative if storage got released.
+ */
+void resourceTrackBytes(GLsizeiptr bytes);
+
+/* move-only owner of an OpenGL object name, the object is released when the handle is destroyed or reset */
+template<eResourceType Type>
+class GLHandle
+{
+public:
+    GLHandle() = default;
+    explicit GLHandle(GLuint name) : name(name) {}
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : name(other.name), bytes(other.bytes)
+    {
+        other.name = 0;
+        other.bytes = 0;
+    }
+
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            name = other.name;
+            bytes = other.bytes;
+            other.name = 0;
+            other.bytes = 0;
+        }
+        return *this;
+    }
+
+    ~GLHandle() { reset(); }
+
+    void reset()
+    {
+        if(name)
+        {
+            resourceRelease(Type, name, bytes);
+        }
+        name = 0;
+        bytes = 0;
+    }
+
+    /* records the storage size of the object for resourceStats() */
+    void setSize(GLsizeiptr size)
+    {
+        resourceTrackBytes(size - bytes);
+        bytes = size;
+    }
+
+    GLsizeiptr size() const { return bytes; }
+    operator GLuint() const { return name; }
+
+private:
+    GLuint name = 0;
+    GLsizeiptr bytes = 0;
+};
+
+using BufferHandle = GLHandle<ResourceBuffer>;
+using VertexArrayHandle = GLHandle<ResourceVertexArray>;
+using ProgramHandle = GLHandle<ResourceProgram>;
+
+/**
+ * @brief Hands out a buffer name. Names are generated in batches so creating many meshes doesn't call glGenBuffers
+ * for every single buffer.
+ *
+ * @return Handle owning the buffer.
+ */
+BufferHandle bufferCreate();
+
+/**
+ * @brief Allocates the storage of a buffer with glBufferData and tracks its size. Leaves the buffer bound to target.
+ *
+ * @param buffer Buffer to allocate.
+ * @param target Binding point used for the upload (GL_ELEMENT_ARRAY_BUFFER also changes the bound VAO).
+ * @param size Size in bytes.
+ * @param data Initial data or nullptr.
+ * @param usage Usage hint (see usage parameter in glBufferData function).
+ */
+void bufferData(BufferHandle& buffer, GLenum target, GLsizeiptr size, const void* data, GLenum usage);
+
+/**
+ * @brief Hands out a vertex array name from a pre-generated batch.
+ *
+ * @return Handle owning the vertex array.
+ */
+VertexArrayHandle vertexArrayCreate();
+
+/**
+ * @brief Creates a shader program object (programs can't be generated in batches).
+ *
+ * @return Handle owning the program.
+ */
+ProgramHandle programCreate();
+
+/**
+ * @brief Fences the objects released during this frame and deletes the ones of earlier frames whose fence has
+ * signaled. Never blocks. Has to be called once per frame after all draws.
+ */
+void resourceFrameEnd();
+
+/**
+ * @brief Returns the current resource counters.
+ *
+ * @return Live objects, buffer storage and queue sizes.
+ */
+ResourceStats resourceStats();
+
+/**
+ * @brief Deletes all queued objects and unused pre-generated names right away. Has to be called before the OpenGL
+ * context is destroyed, handles destroyed afterwards (e.g. globals) don't touch OpenGL anymore.
+ *
+ * usage:
+ *
+ *   meshDelete(myMesh);
+ *   resourceShutdown();
+ *   windowDelete(window);
+ */
+void resourceShutdown();
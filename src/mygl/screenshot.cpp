@@ -0,0 +1,254 @@
+#include "screenshot.h"
+#include "glstate.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stb_image/stb_image_write.h>
+
+#define SCREENSHOT_RING 3u
+#define SCREENSHOT_ENCODERS 2u
+
+namespace detail
+{
+    enum eCaptureState { CaptureFree, CaptureReading, CaptureEncoding };
+
+    /* one pixel pack buffer of the readback ring */
+    struct CaptureSlot
+    {
+        GLuint pbo = 0;
+        GLsizeiptr size = 0;
+        GLsync fence = nullptr;
+        eCaptureState state = CaptureFree;
+
+        int width = 0;
+        int height = 0;
+        std::string path;
+        const unsigned char* pixels = nullptr;  // mapping handed to the encoder
+        std::atomic<bool> encoded{false};
+    };
+
+    struct Screenshots
+    {
+        CaptureSlot slots[SCREENSHOT_RING];
+        std::deque<std::string> requests;
+
+        /* encoder threads, started with the first capture */
+        std::vector<std::thread> encoders;
+        std::deque<CaptureSlot*> jobs;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stop = false;
+
+        unsigned int written = 0;
+    };
+
+    Screenshots& screenshots()
+    {
+        static Screenshots state;
+        return state;
+    }
+
+    void encodeCaptures()
+    {
+        Screenshots& state = screenshots();
+        while(true)
+        {
+            CaptureSlot* slot;
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.wake.wait(lock, [&state]() { return state.stop || !state.jobs.empty(); });
+                if(state.jobs.empty())
+                {
+                    return;
+                }
+                slot = state.jobs.front();
+                state.jobs.pop_front();
+            }
+
+            /* OpenGL rows start at the bottom, start at the last row and walk upwards to flip while encoding */
+            int stride = slot->width * 4;
+            const unsigned char* top = slot->pixels + static_cast<size_t>(slot->height - 1) * stride;
+            if(!stbi_write_png(slot->path.c_str(), slot->width, slot->height, 4, top, -stride))
+            {
+                std::cerr << "[Screenshot] Couldn't write " << slot->path << std::endl;
+            }
+            slot->encoded.store(true, std::memory_order_release);
+        }
+    }
+
+    void startCapture(CaptureSlot& slot, const std::string& path)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        slot.width = viewport[2];
+        slot.height = viewport[3];
+        slot.path = path;
+
+        GLsizeiptr size = static_cast<GLsizeiptr>(slot.width) * slot.height * 4;
+        if(!slot.pbo)
+        {
+            glGenBuffers(1, &slot.pbo);
+        }
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        if(slot.size != size)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            slot.size = size;
+        }
+
+        /* the back buffer (offscreen framebuffer in headless mode) holds the finished frame */
+        glReadBuffer(windowHeadless() ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+        glReadPixels(viewport[0], viewport[1], slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.state = CaptureReading;
+    }
+
+    void encodeCapture(CaptureSlot& slot)
+    {
+        Screenshots& state = screenshots();
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        slot.pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.size, GL_MAP_READ_BIT));
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if(!slot.pixels)
+        {
+            std::cerr << "[Screenshot] Couldn't map readback of " << slot.path << std::endl;
+            slot.state = CaptureFree;
+            return;
+        }
+
+        if(state.encoders.empty())
+        {
+            for(unsigned int i = 0; i < SCREENSHOT_ENCODERS; i++)
+            {
+                state.encoders.emplace_back(encodeCaptures);
+            }
+        }
+
+        slot.encoded.store(false, std::memory_order_relaxed);
+        slot.state = CaptureEncoding;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.jobs.push_back(&slot);
+        }
+        state.wake.notify_one();
+    }
+
+    void releaseCapture(CaptureSlot& slot)
+    {
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glStateBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        std::cout << "[Screenshot] Saved " << slot.path << std::endl;
+        slot.pixels = nullptr;
+        slot.state = CaptureFree;
+        screenshots().written++;
+    }
+}
+
+void screenshotToPNG(const std::string &filepath)
+{
+    detail::screenshots().requests.push_back(filepath);
+}
+
+void screenshotFrameEnd()
+{
+    detail::Screenshots& state = detail::screenshots();
+
+    for(detail::CaptureSlot& slot : state.slots)
+    {
+        /* a readback is only mapped once the GPU is done with it, mapping earlier would wait for the frame */
+        bool readDone = slot.state == detail::CaptureReading &&
+                        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) != GL_TIMEOUT_EXPIRED;
+        if(readDone)
+        {
+            detail::encodeCapture(slot);
+        }
+        else if(slot.state == detail::CaptureEncoding && slot.encoded.load(std::memory_order_acquire))
+        {
+            detail::releaseCapture(slot);
+        }
+    }
+
+    /* requests wait for a free slot if several captures are already in flight */
+    for(detail::CaptureSlot& slot : state.slots)
+    {
+        if(state.requests.empty())
+        {
+            break;
+        }
+        if(slot.state == detail::CaptureFree)
+        {
+            detail::startCapture(slot, state.requests.front());
+            state.requests.pop_front();
+        }
+    }
+}
+
+ScreenshotStats screenshotStats()
+{
+    detail::Screenshots& state = detail::screenshots();
+
+    ScreenshotStats stats;
+    for(const detail::CaptureSlot& slot : state.slots)
+    {
+        stats.reading += slot.state == detail::CaptureReading;
+        stats.encoding += slot.state == detail::CaptureEncoding;
+    }
+    stats.written = state.written;
+    return stats;
+}
+
+void screenshotShutdown()
+{
+    detail::Screenshots& state = detail::screenshots();
+
+    for(detail::CaptureSlot& slot : state.slots)
+    {
+        if(slot.state == detail::CaptureReading)
+        {
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            detail::encodeCapture(slot);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stop = true;
+    }
+    state.wake.notify_all();
+    for(std::thread& encoder : state.encoders)
+    {
+        encoder.join();
+    }
+    state.encoders.clear();
+    state.stop = false;
+
+    for(detail::CaptureSlot& slot : state.slots)
+    {
+        if(slot.state == detail::CaptureEncoding)
+        {
+            detail::releaseCapture(slot);
+        }
+        if(slot.pbo)
+        {
+            glDeleteBuffers(1, &slot.pbo);
+            glStateForget(&slot.pbo, 1, nullptr, 0);
+            slot.pbo = 0;
+            slot.size = 0;
+        }
+    }
+    state.requests.clear();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "base.h"
+
+#include <string>
+
+/* captures in flight, for statistics */
+struct ScreenshotStats
+{
+    unsigned int reading = 0;   // readback into a pixel pack buffer still running on the GPU
+    unsigned int encoding = 0;  // mapped and handed to an encoder thread
+    unsigned int written = 0;
+};
+
+/**
+ * @brief Saves the next presented frame as PNG image without stalling the render thread. The frame is read back into
+ * a pixel pack buffer when it is presented (see windowSwapBuffers), mapped once its fence signaled and flipped and
+ * encoded on a worker thread.
+ *
+ * @param filepath Path to output image.
+ */
+void screenshotToPNG(const std::string &filepath);
+
+/**
+ * @brief Starts the readback of requested captures and hands finished readbacks to the encoder threads. Called by
+ * windowSwapBuffers(...) with the finished frame still in the back buffer.
+ */
+void screenshotFrameEnd();
+
+/**
+ * @brief Returns the number of captures in each stage.
+ *
+ * @return Capture counters.
+ */
+ScreenshotStats screenshotStats();
+
+/**
+ * @brief Finishes all pending captures, stops the encoder threads and releases the pixel pack buffers. Has to be called
+ * while the context is still current, done by windowDelete(...).
+ */
+void screenshotShutdown();
@@ -1,18 +1,42 @@
 #include "shader.h"
+#include "glstate.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
+#include <vector>
+
+#ifdef SHADER_EMBEDDED
+#include "embedded_shaders.h"
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define SHADER_CACHE_DIRECTORY "shadercache"
+#define SHADER_CACHE_MAGIC 0x4E494250u // "PBIN" in little endian
+#define SHADER_WATCH_INTERVAL std::chrono::milliseconds(250)
 
 namespace detail
 {
+    /* queries are left to checkCompile so the driver can compile in the background */
     void compile(GLuint handle, const char* source, const int size)
     {
-        GLint compileResult = 0;
-
         glShaderSource(handle, 1, &source, &size);
         glCompileShader(handle);
+    }
+
+    void checkCompile(GLuint handle)
+    {
+        GLint compileResult = 0;
         glGetShaderiv(handle, GL_COMPILE_STATUS, &compileResult);
 
         if(compileResult == GL_FALSE)
@@ -31,10 +55,8 @@ namespace detail
         }
     }
 
-    void link(GLuint handle)
+    void checkLink(GLuint handle)
     {
-        glLinkProgram(handle);
-
         GLint result;
         glGetProgramiv(handle, GL_LINK_STATUS, &result);
 
@@ -57,11 +79,253 @@ namespace detail
             throw std::runtime_error((std::string("[Shader] ERROR link shaderprogram: \n") + programLog));
         }
     }
+
+    /* collect locations of all active uniforms once, uniforms inside blocks have no location and are skipped */
+    void reflectUniforms(ShaderProgram& program)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name(static_cast<std::size_t>(maxLength), '\0');
+        program.uniforms.clear();
+        program.uniforms.reserve(count);
+
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            UniformHandle uniform;
+            glGetActiveUniform(program.id, i, maxLength, &length, &uniform.size, &uniform.type, &name[0]);
+
+            std::string uniformName = name.substr(0, length);
+            uniform.location = glGetUniformLocation(program.id, uniformName.c_str());
+            if(uniform.location < 0)
+            {
+                continue;
+            }
+
+            program.uniforms[uniformName] = uniform;
+            if(uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            {
+                program.uniforms[uniformName.substr(0, uniformName.size() - 3)] = uniform;
+            }
+        }
+    }
+
+    void reflectUniformBlocks(ShaderProgram& program)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+
+        std::string name(static_cast<std::size_t>(maxLength), '\0');
+        program.uniformBlocks.clear();
+
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(program.id, i, maxLength, &length, &name[0]);
+            program.uniformBlocks[name.substr(0, length)] = i;
+        }
+
+        /* shared blocks live at fixed binding points, so no program needs per-frame uploads of its own */
+        const std::pair<const char*, eUniformBlockBinding> shared[] = {{"PerFrame", eUniformBlockBinding::PerFrame},
+                                                                       {"Palette", eUniformBlockBinding::Palette}};
+        for(const auto& block : shared)
+        {
+            auto it = program.uniformBlocks.find(block.first);
+            if(it != program.uniformBlocks.end())
+            {
+                glUniformBlockBinding(program.id, it->second, block.second);
+            }
+        }
+    }
+
+    uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    /* path of the cached binary, keyed by the sources and the driver, empty if binaries aren't supported */
+    std::string programCachePath(const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        GLint formats = 0;
+        if(GLAD_GL_ARB_get_program_binary)
+        {
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        }
+        if(formats == 0)
+        {
+            return "";
+        }
+
+        uint64_t hash = 0xcbf29ce484222325ull;
+        hash = fnv1a(hash, vertexSource.c_str(), vertexSource.size() + 1);
+        hash = fnv1a(hash, fragmentSource.c_str(), fragmentSource.size() + 1);
+        for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char* value = reinterpret_cast<const char*>(glGetString(name));
+            hash = fnv1a(hash, value, value ? std::strlen(value) + 1 : 0);
+        }
+
+        std::ostringstream path;
+        path << SHADER_CACHE_DIRECTORY << "/" << std::hex << hash << ".glbin";
+        return path.str();
+    }
+
+    struct ProgramBinaryHeader
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    bool loadProgramBinary(GLuint program, const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        ProgramBinaryHeader header = {};
+        if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SHADER_CACHE_MAGIC)
+        {
+            return false;
+        }
+
+        std::vector<char> binary(header.length);
+        if(!file.read(binary.data(), binary.size()))
+        {
+            return false;
+        }
+
+        glProgramBinary(program, header.format, binary.data(), binary.size());
+        GLint result = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &result);
+        if(result == GL_FALSE)
+        {
+            /* rejected after a driver update the key didn't catch, rebuild it */
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            return false;
+        }
+        return true;
+    }
+
+    void storeProgramBinary(GLuint program, const std::string& path)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0)
+        {
+            return;
+        }
+
+        ProgramBinaryHeader header = {SHADER_CACHE_MAGIC, 0, static_cast<uint32_t>(length)};
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, nullptr, &format, binary.data());
+        header.format = format;
+
+        /* a missing cache is not an error, the program just gets compiled again next time */
+        std::error_code error;
+        std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), binary.size());
+    }
+
+    /* checks the results of a build, stores its binary and reflects the interface, only blocks if still compiling */
+    void finishBuild(ShaderProgram& program)
+    {
+        bool cached = !program._vertexID;
+        if(!cached)
+        {
+            program.building = false;
+            checkCompile(program._vertexID);
+            checkCompile(program._fragmentID);
+            checkLink(program.id);
+
+            if(!program.cachePath.empty())
+            {
+                storeProgramBinary(program.id, program.cachePath);
+            }
+        }
+
+        reflectUniforms(program);
+        reflectUniformBlocks(program);
+
+        std::cout << "[Shader] Program " << (cached ? "loaded from cache" : "compiled") << " in "
+                  << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - program.buildStart).count() << " ms" << std::endl;
+    }
 }
 
 ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
 {
-    ShaderProgram program{glCreateProgram(), glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER)};
+    ShaderProgram program = shaderCreateAsync(vertexSource, fragmentSource);
+    if(program.building)
+    {
+        detail::finishBuild(program);
+    }
+    return program;
+}
+
+ShaderProgram shaderCreateCompute(const std::string &computeSource)
+{
+    ShaderProgram program;
+    program.buildStart = std::chrono::steady_clock::now();
+    program.id = programCreate();
+
+    GLuint computeID = glCreateShader(GL_COMPUTE_SHADER);
+    if(!computeID || !program.id)
+    {
+        std::cerr << "[Shader] Couldn't create compute program!" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Couldn't create compute program!");
+    }
+
+    detail::compile(computeID, computeSource.c_str(), computeSource.size());
+    try
+    {
+        detail::checkCompile(computeID);
+    }
+    catch(const std::runtime_error&)
+    {
+        glDeleteShader(computeID);
+        throw;
+    }
+    glAttachShader(program.id, computeID);
+    glLinkProgram(program.id);
+
+    /* the linked program keeps working without its shader object */
+    glDetachShader(program.id, computeID);
+    glDeleteShader(computeID);
+    detail::checkLink(program.id);
+
+    detail::reflectUniforms(program);
+    detail::reflectUniformBlocks(program);
+
+    std::cout << "[Shader] Compute program compiled in "
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - program.buildStart).count() << " ms" << std::endl;
+    return program;
+}
+
+ShaderProgram shaderCreateAsync(const std::string &vertexSource, const std::string &fragmentSource)
+{
+    ShaderProgram program;
+    program.buildStart = std::chrono::steady_clock::now();
+    program.id = programCreate();
+
+    std::string cachePath = detail::programCachePath(vertexSource, fragmentSource);
+    if(program.id && !cachePath.empty() && detail::loadProgramBinary(program.id, cachePath))
+    {
+        detail::finishBuild(program);
+        return program;
+    }
+
+    program._vertexID = glCreateShader(GL_VERTEX_SHADER);
+    program._fragmentID = glCreateShader(GL_FRAGMENT_SHADER);
 
     if(!program._vertexID || !program._fragmentID || !program.id)
     {
@@ -70,17 +334,52 @@ ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &f
         throw std::runtime_error("[Shader] Couldn't create shader program!");
     }
 
+    /* let the driver use as many compiler threads as it likes */
+    static bool parallelCompile = false;
+    if(GLAD_GL_KHR_parallel_shader_compile && !parallelCompile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+        parallelCompile = true;
+    }
+
     detail::compile(program._vertexID, vertexSource.c_str(), vertexSource.size());
     glAttachShader(program.id, program._vertexID);
 
     detail::compile(program._fragmentID, fragmentSource.c_str(), fragmentSource.size());
     glAttachShader(program.id, program._fragmentID);
 
-    detail::link(program.id);
+    if(!cachePath.empty())
+    {
+        glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program.id);
 
+    program.building = true;
+    program.cachePath = cachePath;
     return program;
 }
 
+bool shaderPoll(ShaderProgram &program)
+{
+    if(!program.building)
+    {
+        return true;
+    }
+
+    if(GLAD_GL_KHR_parallel_shader_compile)
+    {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &completed);
+        if(completed == GL_FALSE)
+        {
+            return false;
+        }
+    }
+
+    detail::finishBuild(program);
+    return true;
+}
+
 ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
 {
     std::ifstream vertexFile(vertexPath);
@@ -109,36 +408,411 @@ ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragm
     return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str());
 }
 
-void shaderDelete(const ShaderProgram &program)
+std::string shaderSource(const std::string &name)
 {
-    glDetachShader(program.id, program._vertexID);
-    glDetachShader(program.id, program._fragmentID);
-    glDeleteShader(program._vertexID);
-    glDeleteShader(program._fragmentID);
+#ifdef SHADER_EMBEDDED
+    for(const auto& shader : sEmbeddedShaders)
+    {
+        if(name == shader.name)
+        {
+            return shader.source;
+        }
+    }
+#endif
 
-    glDeleteProgram(program.id);
+    return shaderSourceFile(name);
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D &value)
+std::string shaderSourceFile(const std::string &name)
+{
+    std::ifstream file(SHADER_SOURCE_DIRECTORY + name);
+    if(!file.is_open())
+    {
+        std::cerr << "[Shader] Couldn't find shader source " << name << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Couldn't find shader source " + name);
+    }
+
+    std::stringstream source;
+    source << file.rdbuf();
+    return source.str();
+}
+
+void shaderDelete(ShaderProgram &program)
+{
+    /* programs loaded from the binary cache have no shader objects */
+    if(program._vertexID)
+    {
+        glDetachShader(program.id, program._vertexID);
+        glDeleteShader(program._vertexID);
+    }
+    if(program._fragmentID)
+    {
+        glDetachShader(program.id, program._fragmentID);
+        glDeleteShader(program._fragmentID);
+    }
+
+    /* the program itself is deleted once the frames using it are done */
+    program = ShaderProgram();
+}
+
+UniformHandle shaderUniformHandle(const ShaderProgram &shader, const std::string &name)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    auto it = shader.uniforms.find(name);
+    if(it == shader.uniforms.end())
     {
-        std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
+        std::cerr << "[Shader] Couldn't find uniform " << name << std::endl;
         std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
+        throw std::runtime_error("[Shader] Couldn't find uniform " + name);
     }
-    glUniformMatrix4fv(index, 1, GL_FALSE, value.ptr());
+    return it->second;
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D &value)
+{
+    shaderUniform(shaderUniformHandle(shader, name), value);
 }
 
 void shaderUniform(ShaderProgram &shader, const std::string &name, int value)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    shaderUniform(shaderUniformHandle(shader, name), value);
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, float value)
+{
+    shaderUniform(shaderUniformHandle(shader, name), value);
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector3D &value)
+{
+    shaderUniform(shaderUniformHandle(shader, name), value);
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector4D &value)
+{
+    shaderUniform(shaderUniformHandle(shader, name), value);
+}
+
+void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix3D &value)
+{
+    shaderUniform(shaderUniformHandle(shader, name), value);
+}
+
+void shaderUniform(const UniformHandle &uniform, const Matrix4D &value)
+{
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, value.ptr());
+}
+
+void shaderUniform(const UniformHandle &uniform, const Matrix3D &value)
+{
+    glUniformMatrix3fv(uniform.location, 1, GL_FALSE, value.ptr());
+}
+
+void shaderUniform(const UniformHandle &uniform, const Vector4D &value)
+{
+    glUniform4f(uniform.location, value.x, value.y, value.z, value.w);
+}
+
+void shaderUniform(const UniformHandle &uniform, const Vector3D &value)
+{
+    glUniform3f(uniform.location, value.x, value.y, value.z);
+}
+
+void shaderUniform(const UniformHandle &uniform, float value)
+{
+    glUniform1f(uniform.location, value);
+}
+
+void shaderUniform(const UniformHandle &uniform, int value)
+{
+    glUniform1i(uniform.location, value);
+}
+
+void shaderUniformBlock(ShaderProgram &shader, const std::string &name, GLuint binding)
+{
+    auto it = shader.uniformBlocks.find(name);
+    if(it == shader.uniformBlocks.end())
     {
-        std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
+        std::cerr << "[Shader] Couldn't find uniform block " << name << std::endl;
         std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
+        throw std::runtime_error("[Shader] Couldn't find uniform block " + name);
+    }
+    glUniformBlockBinding(shader.id, it->second, binding);
+}
+
+void uniformBlockUpload(StreamBuffer &stream, GLuint binding, const void *data, GLsizeiptr size)
+{
+    static GLint alignment = 0;
+    if(alignment == 0)
+    {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    }
+
+    StreamAllocation block = streamBufferMap(stream, size, alignment);
+    std::memcpy(block.data, data, size);
+    streamBufferUnmap(stream);
+
+    glStateBindBufferRange(GL_UNIFORM_BUFFER, binding, stream.id, block.offset, size);
+}
+
+std::string shaderInjectDefines(const std::string &source, const std::vector<std::string> &defines)
+{
+    if(defines.empty())
+    {
+        return source;
+    }
+
+    /* #version has to stay the first directive */
+    size_t insert = 0;
+    size_t version = source.find("#version");
+    if(version != std::string::npos)
+    {
+        insert = source.find('\n', version);
+        insert = (insert == std::string::npos) ? source.size() : insert + 1;
+    }
+    int nextLine = 1 + static_cast<int>(std::count(source.begin(), source.begin() + insert, '\n'));
+
+    std::string block;
+    for(const std::string& define : defines)
+    {
+        block += "#define " + define + "\n";
+    }
+    block += "#line " + std::to_string(nextLine) + "\n";
+
+    std::string result = source;
+    result.insert(insert, block);
+    return result;
+}
+
+ShaderPermutations shaderPermutationsCreate(const std::string &vertexSource, const std::string &fragmentSource, const std::vector<std::string> &features)
+{
+    if(features.size() > 32)
+    {
+        std::cerr << "[Shader] Too many permutation features (" << features.size() << ")" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Shader] Too many permutation features (" + std::to_string(features.size()) + ")");
+    }
+
+    ShaderPermutations permutations;
+    permutations.vertexSource = vertexSource;
+    permutations.fragmentSource = fragmentSource;
+    permutations.features = features;
+    return permutations;
+}
+
+namespace detail
+{
+    ShaderProgram buildVariant(const ShaderPermutations& permutations, uint32_t featureMask)
+    {
+        std::vector<std::string> defines;
+        for(unsigned int i = 0; i < permutations.features.size(); i++)
+        {
+            if(featureMask & (1u << i))
+            {
+                defines.push_back(permutations.features[i]);
+            }
+        }
+
+        return shaderCreateAsync(shaderInjectDefines(permutations.vertexSource, defines),
+                                 shaderInjectDefines(permutations.fragmentSource, defines));
+    }
+
+    /* swaps in a finished build, a failed build keeps the previous program */
+    void updateVariant(ShaderVariant& variant)
+    {
+        if(!variant.building.id)
+        {
+            return;
+        }
+
+        try
+        {
+            if(!shaderPoll(variant.building))
+            {
+                return;
+            }
+        }
+        catch(const std::runtime_error&)
+        {
+            std::cerr << "[Shader] Build failed, " << (variant.program.id ? "keeping the previous program" : "using the fallback") << std::endl;
+            shaderDelete(variant.building);
+            return;
+        }
+
+        if(variant.program.id)
+        {
+            shaderDelete(variant.program);
+        }
+        variant.program = std::move(variant.building);
+        variant.building = ShaderProgram();
+    }
+}
+
+ShaderProgram &shaderPermutation(ShaderPermutations &permutations, uint32_t featureMask)
+{
+    ShaderVariant& variant = permutations.variants[featureMask];
+    detail::updateVariant(variant);
+    if(variant.program.id)
+    {
+        return variant.program;
+    }
+
+    /* not built yet, finish it right here */
+    ShaderProgram program = variant.building.id ? std::move(variant.building) : detail::buildVariant(permutations, featureMask);
+    variant.building = ShaderProgram();
+    if(program.building)
+    {
+        detail::finishBuild(program);
+    }
+    variant.program = std::move(program);
+    return variant.program;
+}
+
+ShaderProgram &shaderPermutationSelect(ShaderPermutations &permutations, uint32_t featureMask, uint32_t fallbackMask)
+{
+    auto it = permutations.variants.find(featureMask);
+    if(it == permutations.variants.end())
+    {
+        it = permutations.variants.emplace(featureMask, ShaderVariant()).first;
+        it->second.building = detail::buildVariant(permutations, featureMask);
+    }
+
+    detail::updateVariant(it->second);
+    if(it->second.program.id)
+    {
+        return it->second.program;
+    }
+    return shaderPermutation(permutations, fallbackMask);
+}
+
+void shaderPermutationsPrecompile(ShaderPermutations &permutations, const std::vector<uint32_t> &featureMasks)
+{
+    for(uint32_t featureMask : featureMasks)
+    {
+        ShaderVariant& variant = permutations.variants[featureMask];
+        if(!variant.program.id && !variant.building.id)
+        {
+            variant.building = detail::buildVariant(permutations, featureMask);
+        }
+    }
+}
+
+void shaderPermutationsReload(ShaderPermutations &permutations, const std::string &vertexSource, const std::string &fragmentSource)
+{
+    permutations.vertexSource = vertexSource;
+    permutations.fragmentSource = fragmentSource;
+
+    for(auto& entry : permutations.variants)
+    {
+        if(entry.second.building.id)
+        {
+            shaderDelete(entry.second.building);
+        }
+        entry.second.building = detail::buildVariant(permutations, entry.first);
+    }
+}
+
+void shaderPermutationsDelete(ShaderPermutations &permutations)
+{
+    for(auto& entry : permutations.variants)
+    {
+        shaderDelete(entry.second.program);
+        shaderDelete(entry.second.building);
+    }
+    permutations = ShaderPermutations();
+}
+
+ShaderWatcher shaderWatcherCreate(const std::string &directory)
+{
+    ShaderWatcher watcher;
+    watcher.directory = directory;
+
+    std::error_code error;
+    if(!std::filesystem::is_directory(directory, error))
+    {
+        std::cout << "[Shader] " << directory << " doesn't exist, hot reload disabled" << std::endl;
+        return watcher;
+    }
+
+#ifdef __linux__
+    /* editors either write in place or save to a temporary file and rename it */
+    watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watcher.fd >= 0 && inotify_add_watch(watcher.fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(watcher.fd);
+        watcher.fd = -1;
+    }
+#endif
+
+    for(const auto& entry : std::filesystem::directory_iterator(directory, error))
+    {
+        watcher.modified[entry.path().filename().string()] = entry.last_write_time(error);
+    }
+    watcher.lastScan = std::chrono::steady_clock::now();
+    return watcher;
+}
+
+std::vector<std::string> shaderWatcherPoll(ShaderWatcher &watcher)
+{
+    std::vector<std::string> changed;
+    auto add = [&changed](const std::string& name)
+    {
+        if(std::find(changed.begin(), changed.end(), name) == changed.end())
+        {
+            changed.push_back(name);
+        }
+    };
+
+#ifdef __linux__
+    if(watcher.fd >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while((length = read(watcher.fd, buffer, sizeof(buffer))) > 0)
+        {
+            for(char* pointer = buffer; pointer < buffer + length; )
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(pointer);
+                if(event->len > 0)
+                {
+                    add(event->name);
+                }
+                pointer += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+
+    auto now = std::chrono::steady_clock::now();
+    if(watcher.directory.empty() || now - watcher.lastScan < SHADER_WATCH_INTERVAL)
+    {
+        return changed;
+    }
+    watcher.lastScan = now;
+
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(watcher.directory, error))
+    {
+        std::string name = entry.path().filename().string();
+        std::filesystem::file_time_type time = entry.last_write_time(error);
+        auto it = watcher.modified.find(name);
+        if(it == watcher.modified.end() || it->second != time)
+        {
+            watcher.modified[name] = time;
+            add(name);
+        }
+    }
+    return changed;
+}
+
+void shaderWatcherDelete(ShaderWatcher &watcher)
+{
+#ifdef __linux__
+    if(watcher.fd >= 0)
+    {
+        close(watcher.fd);
     }
-    glUniform1i(index, value);
+#endif
+    watcher = ShaderWatcher();
 }
@@ -1,12 +1,86 @@
 #pragma once
 
 #include "base.h"
+#include "resource.h"
+#include "streambuffer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* shader sources relative to the working directory, read by shaderSourceFile and watched for hot reload */
+#define SHADER_SOURCE_DIRECTORY "../../src/shader/"
+
+/* fixed binding points of the shared uniform blocks, programs declaring a block get it bound at link time */
+enum eUniformBlockBinding { PerFrame = 0, Palette = 1 };
+
+/* std140 layout of the per-frame block:
+ *
+ *   layout(std140) uniform PerFrame
+ *   {
+ *       mat4 uView;
+ *       mat4 uProj;
+ *       mat4 uViewProj;
+ *       vec4 uCameraPosition;
+ *       float uTime;
+ *   };
+ */
+struct PerFrameBlock
+{
+    Matrix4D view;
+    Matrix4D proj;
+    Matrix4D viewProj;
+    Vector4D cameraPosition;
+    float time;
+    float _padding[3];
+};
+static_assert(sizeof(PerFrameBlock) == 224, "PerFrameBlock has to match the std140 layout of the PerFrame block");
+
+/* pre-resolved uniform of a linked program, setting it needs no string lookup */
+struct UniformHandle
+{
+    GLint location = -1;
+    GLenum type = GL_NONE;
+    GLint size = 0;  // number of array elements
+};
 
 struct ShaderProgram
 {
-    GLuint id = 0;
+    ProgramHandle id;
     GLuint _vertexID = 0;
     GLuint _fragmentID = 0;
+
+    /* active uniforms reflected after linking, arrays are also listed without the "[0]" suffix */
+    std::unordered_map<std::string, UniformHandle> uniforms;
+
+    /* active uniform blocks, name -> block index */
+    std::unordered_map<std::string, GLuint> uniformBlocks;
+
+    /* state of a build started with shaderCreateAsync */
+    bool building = false;
+    std::string cachePath;
+    std::chrono::steady_clock::time_point buildStart;
+};
+
+/* one feature combination of a shader */
+struct ShaderVariant
+{
+    ShaderProgram program;   // last program that linked, id is 0 until the first build finished
+    ShaderProgram building;  // build in flight, replaces program once it is done
+};
+
+/* all variants of one shader, bit i of a feature mask adds "#define features[i]" to both sources */
+struct ShaderPermutations
+{
+    std::string vertexSource;
+    std::string fragmentSource;
+    std::vector<std::string> features;
+
+    /* variants requested so far, feature mask -> variant */
+    std::unordered_map<uint32_t, ShaderVariant> variants;
 };
 
 /**
@@ -20,7 +94,9 @@ struct ShaderProgram
 ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath);
 
 /**
- * @brief Function to compile and link vertex and fragement source strings to create shader program.
+ * @brief Function to compile and link vertex and fragement source strings to create shader program. If
+ * GL_ARB_get_program_binary is available, linked programs are cached on disk (keyed by the sources and the driver
+ * vendor, renderer and version) and loaded from there on the next start instead of being compiled.
  *
  * @param vertexSource Source string holding vertex shader code.
  * @param fragmentSource Source string holding fragment shader code.
@@ -29,12 +105,73 @@ ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragm
  */
 ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource);
 
+/**
+ * @brief Compiles and links a compute shader program (GL_ARB_compute_shader). Compute programs are small and only built
+ * at startup, so they are compiled synchronously and not cached.
+ *
+ * @param computeSource Source string holding compute shader code.
+ *
+ * @return Shader program.
+ */
+ShaderProgram shaderCreateCompute(const std::string& computeSource);
+
+/**
+ * @brief Returns the source of a shader embedded into the executable at build time (see cmake/EmbedShaders.cmake).
+ * Builds without embedded shaders read the file from the source tree instead.
+ *
+ * @param name File name of the shader inside src/shader.
+ *
+ * @return Shader source.
+ *
+ * usage:
+ *
+ *   ShaderProgram shader = shaderCreate(shaderSource("default.vert"), shaderSource("default.frag"));
+ */
+std::string shaderSource(const std::string& name);
+
+/**
+ * @brief Reads a shader source from the source tree, bypassing the embedded copy (used for hot reloading).
+ *
+ * @param name File name of the shader inside src/shader.
+ *
+ * @return Shader source.
+ */
+std::string shaderSourceFile(const std::string& name);
+
+/**
+ * @brief Starts compiling and linking a shader program without waiting for the driver. With
+ * GL_KHR_parallel_shader_compile the work runs on driver threads, otherwise it is finished on the first poll.
+ * Programs found in the binary cache are ready right away.
+ *
+ * @param vertexSource Source string holding vertex shader code.
+ * @param fragmentSource Source string holding fragment shader code.
+ *
+ * @return Shader program that must not be used before shaderPoll(...) returned true.
+ *
+ * usage:
+ *
+ *   ShaderProgram shader = shaderCreateAsync(vertex-source, fragment-source);
+ *   ...
+ *   glUseProgram(shaderPoll(shader) ? shader.id : fallback.id);
+ */
+ShaderProgram shaderCreateAsync(const std::string& vertexSource, const std::string& fragmentSource);
+
+/**
+ * @brief Checks whether an asynchronous build finished without blocking (if GL_KHR_parallel_shader_compile is
+ * available). Finished builds are checked for errors, cached and reflected.
+ *
+ * @param program Program returned by shaderCreateAsync(...).
+ *
+ * @return Whether the program can be used, throws if compiling or linking failed.
+ */
+bool shaderPoll(ShaderProgram& program);
+
 /**
  * @brief Cleanup and delete all shaders of a shader program and the program itself. Has to be called for each shader program after it is not used anymore.
  *
  * @param program Shader program to delete.
  */
-void shaderDelete(const ShaderProgram& program);
+void shaderDelete(ShaderProgram& program);
 
 /**
  * @brief Function to set uniform in shader program.
@@ -53,3 +190,250 @@ void shaderUniform(ShaderProgram& shader, const std::string& name, const Matrix4
  * @param value Value to which the uniform should be set.
  */
 void shaderUniform(ShaderProgram& shader, const std::string& name, int value);
+
+/**
+ * @brief Looks up a uniform in the table reflected at link time. Resolve handles once after loading the shader and
+ * use them with shaderUniform(UniformHandle, ...) in the render loop.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ *
+ * @return Handle of the uniform, throws if the uniform is not active in the program.
+ *
+ * usage:
+ *
+ *   UniformHandle uProj = shaderUniformHandle(shader, "uProj");
+ *   glUseProgram(shader.id);
+ *   shaderUniform(uProj, cameraProjection(camera));
+ */
+UniformHandle shaderUniformHandle(const ShaderProgram& shader, const std::string& name);
+
+/**
+ * @brief Function to set uniform in shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(ShaderProgram& shader, const std::string& name, float value);
+
+/**
+ * @brief Function to set uniform in shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(ShaderProgram& shader, const std::string& name, const Vector3D& value);
+
+/**
+ * @brief Function to set uniform in shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(ShaderProgram& shader, const std::string& name, const Vector4D& value);
+
+/**
+ * @brief Function to set uniform in shader program.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name.
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(ShaderProgram& shader, const std::string& name, const Matrix3D& value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, const Matrix4D& value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, const Matrix3D& value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, const Vector4D& value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, const Vector3D& value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, float value);
+
+/**
+ * @brief Function to set a uniform of the currently bound shader program through a pre-resolved handle.
+ *
+ * @param uniform Uniform handle (see shaderUniformHandle(...)).
+ * @param value Value to which the uniform should be set.
+ */
+void shaderUniform(const UniformHandle& uniform, int value);
+
+/**
+ * @brief Binds a uniform block of a shader program to a binding point. Blocks named after eUniformBlockBinding are
+ * bound automatically when the program is linked.
+ *
+ * @param shader Shader program.
+ * @param name Block name.
+ * @param binding Binding point (see glBindBufferRange).
+ */
+void shaderUniformBlock(ShaderProgram& shader, const std::string& name, GLuint binding);
+
+/**
+ * @brief Writes std140 data into the stream buffer and binds the range to a uniform buffer binding point, where it
+ * stays visible to every program until the binding changes.
+ *
+ * @param stream Stream buffer receiving the data.
+ * @param binding Binding point.
+ * @param data Block data in std140 layout.
+ * @param size Size of the block in bytes.
+ *
+ * usage:
+ *
+ *   PerFrameBlock frame = {...};
+ *   uniformBlockUpload(stream, eUniformBlockBinding::PerFrame, &frame, sizeof(frame));
+ */
+void uniformBlockUpload(StreamBuffer& stream, GLuint binding, const void* data, GLsizeiptr size);
+
+/**
+ * @brief Inserts #define lines into a shader source right after its #version directive. A #line directive keeps the
+ * line numbers of compiler messages matching the original source.
+ *
+ * @param source Shader source.
+ * @param defines Names to define.
+ *
+ * @return Source with defines.
+ */
+std::string shaderInjectDefines(const std::string& source, const std::vector<std::string>& defines);
+
+/**
+ * @brief Sets up the permutations of a shader. No program is compiled until a variant is requested.
+ *
+ * @param vertexSource Source string holding vertex shader code.
+ * @param fragmentSource Source string holding fragment shader code.
+ * @param features Define names, the index of a name is its bit in feature masks (at most 32).
+ *
+ * @return Permutation set.
+ *
+ * usage:
+ *
+ *   ShaderPermutations shader = shaderPermutationsCreate(vertex-source, fragment-source, {"CHECKERBOARD"});
+ *   glUseProgram(shaderPermutationSelect(shader, 1u << 0).id);
+ */
+ShaderPermutations shaderPermutationsCreate(const std::string& vertexSource, const std::string& fragmentSource, const std::vector<std::string>& features);
+
+/**
+ * @brief Returns the program of a feature combination and compiles it on first use, blocking until it is linked.
+ *
+ * @param permutations Permutation set.
+ * @param featureMask Enabled features.
+ *
+ * @return Shader program of the variant, stays valid until the variant is rebuilt or deleted.
+ */
+ShaderProgram& shaderPermutation(ShaderPermutations& permutations, uint32_t featureMask);
+
+/**
+ * @brief Returns the program of a feature combination for drawing without ever waiting for the compiler. A variant
+ * that isn't built yet is started asynchronously and the fallback variant is returned until it is ready.
+ *
+ * @param permutations Permutation set.
+ * @param featureMask Enabled features.
+ * @param fallbackMask Variant used while the requested one is building, built synchronously if necessary.
+ *
+ * @return Shader program to draw with in this frame.
+ */
+ShaderProgram& shaderPermutationSelect(ShaderPermutations& permutations, uint32_t featureMask, uint32_t fallbackMask = 0);
+
+/**
+ * @brief Starts building variants ahead of time, e.g. during loading, so the first draw using them doesn't hitch.
+ * Doesn't wait for the builds.
+ *
+ * @param permutations Permutation set.
+ * @param featureMasks Feature combinations to compile.
+ */
+void shaderPermutationsPrecompile(ShaderPermutations& permutations, const std::vector<uint32_t>& featureMasks);
+
+/**
+ * @brief Replaces the sources of a permutation set and rebuilds all variants asynchronously. Each variant keeps
+ * drawing with its previous program until the new one linked, failed builds keep the previous program.
+ *
+ * @param permutations Permutation set.
+ * @param vertexSource New vertex shader source.
+ * @param fragmentSource New fragment shader source.
+ */
+void shaderPermutationsReload(ShaderPermutations& permutations, const std::string& vertexSource, const std::string& fragmentSource);
+
+/**
+ * @brief Deletes all compiled variants of a permutation set.
+ *
+ * @param permutations Permutation set to delete.
+ */
+void shaderPermutationsDelete(ShaderPermutations& permutations);
+
+/* watches a shader directory for saved files */
+struct ShaderWatcher
+{
+    std::string directory;
+
+    /* inotify descriptor on linux, -1 if the modification times are scanned instead */
+    int fd = -1;
+
+    /* fallback: last seen modification time per file, rescanned at most every few hundred milliseconds */
+    std::unordered_map<std::string, std::filesystem::file_time_type> modified;
+    std::chrono::steady_clock::time_point lastScan;
+};
+
+/**
+ * @brief Starts watching a shader directory.
+ *
+ * @param directory Directory containing the shader sources.
+ *
+ * @return Watcher, unwatched if the directory doesn't exist (e.g. in a deployed build with embedded shaders).
+ *
+ * usage:
+ *
+ *   ShaderWatcher watcher = shaderWatcherCreate();
+ *   for(const std::string& name : shaderWatcherPoll(watcher))
+ *       ... shaderPermutationsReload(shader, shaderSourceFile(vertex-name), shaderSourceFile(fragment-name))
+ */
+ShaderWatcher shaderWatcherCreate(const std::string& directory = SHADER_SOURCE_DIRECTORY);
+
+/**
+ * @brief Returns the files of the watched directory that were written since the last poll. Never blocks, has to be
+ * called once per frame.
+ *
+ * @param watcher Watcher.
+ *
+ * @return File names relative to the watched directory, each name at most once.
+ */
+std::vector<std::string> shaderWatcherPoll(ShaderWatcher& watcher);
+
+/**
+ * @brief Stops watching.
+ *
+ * @param watcher Watcher to delete.
+ */
+void shaderWatcherDelete(ShaderWatcher& watcher);
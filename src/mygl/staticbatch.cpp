@@ -0,0 +1,110 @@
+#include "staticbatch.h"
+#include "arena.h"
+#include "glstate.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+
+StaticBatch staticBatchCreate(const std::vector<StaticBatchPart>& parts)
+{
+    if(parts.size() > STATIC_BATCH_MAX_PARTS)
+    {
+        std::cerr << "[StaticBatch] " << parts.size() << " parts exceed the palette size of " << STATIC_BATCH_MAX_PARTS << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[StaticBatch] Too many parts for the palette");
+    }
+
+    size_t vertexCount = 0, indexCount = 0;
+    for(const StaticBatchPart& part : parts)
+    {
+        vertexCount += part.vertices.size();
+        indexCount += part.indices.size();
+    }
+
+    /* merged data only lives until the upload */
+    LinearArena& staging = arenaStaging();
+    BatchVertex* vertices = arenaAllocArray<BatchVertex>(staging, vertexCount);
+    unsigned int* indices = arenaAllocArray<unsigned int>(staging, indexCount);
+
+    size_t vertex = 0, index = 0;
+    for(GLuint p = 0; p < parts.size(); p++)
+    {
+        unsigned int base = vertex;
+        for(const Vertex& v : parts[p].vertices)
+        {
+            vertices[vertex++] = {v.pos, v.color, p};
+        }
+        for(unsigned int i : parts[p].indices)
+        {
+            indices[index++] = base + i;
+        }
+    }
+
+    StaticBatch batch;
+    batch.vao = vertexArrayCreate();
+    batch.vbo = bufferCreate();
+    batch.ebo = bufferCreate();
+
+    glStateBindVertexArray(batch.vao);
+    {
+        bufferData(batch.vbo, GL_ARRAY_BUFFER, vertexCount * sizeof(BatchVertex), vertices, GL_STATIC_DRAW);
+        bufferData(batch.ebo, GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+        glEnableVertexAttribArray(eDataIdx::Position);
+        glEnableVertexAttribArray(eDataIdx::Color);
+        glEnableVertexAttribArray(eBatchDataIdx::Part);
+        glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) offsetof(BatchVertex, pos));
+        glVertexAttribPointer(eDataIdx::Color,      4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*) offsetof(BatchVertex, color));
+        glVertexAttribIPointer(eBatchDataIdx::Part, 1, GL_UNSIGNED_INT,    sizeof(BatchVertex), (void*) offsetof(BatchVertex, part));
+        glCheckError();
+    }
+
+    /* unbind so later element array binds can't modify this VAO */
+    glStateBindVertexArray(0);
+
+    batch.size_vbo = vertexCount;
+    batch.size_ibo = indexCount;
+    batch.palette.assign(parts.size(), Matrix4D::identity());
+    return batch;
+}
+
+StaticBatchPart staticBatchPart(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color)
+{
+    StaticBatchPart part;
+    part.vertices.reserve(positions.size());
+    for(const Vector3D& position : positions)
+    {
+        part.vertices.push_back({position, color});
+    }
+    part.indices = indices;
+    return part;
+}
+
+void staticBatchDelete(StaticBatch& batch)
+{
+    batch = StaticBatch();
+}
+
+void staticBatchDraw(const StaticBatch& batch, StreamBuffer& stream)
+{
+    staticBatchDraw(batch, batch.palette.data(), static_cast<unsigned int>(batch.palette.size()), stream);
+}
+
+void staticBatchDraw(const StaticBatch& batch, const Matrix4D* palette, unsigned int count, StreamBuffer& stream)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    /* the bound range has to cover the whole block as declared in the shader */
+    Matrix4D block[STATIC_BATCH_MAX_PARTS];
+    std::copy(palette, palette + std::min(count, static_cast<unsigned int>(STATIC_BATCH_MAX_PARTS)), block);
+    uniformBlockUpload(stream, eUniformBlockBinding::Palette, block, sizeof(block));
+
+    glStateBindVertexArray(batch.vao);
+    glDrawElements(GL_TRIANGLES, batch.size_ibo, GL_UNSIGNED_INT, nullptr);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "base.h"
+#include "mesh.h"
+#include "resource.h"
+#include "streambuffer.h"
+
+#include <vector>
+
+/* has to match the size of uPalette in the PALETTE variant of default.vert */
+#define STATIC_BATCH_MAX_PARTS 16
+
+/* vertex attribute location of the part index (after the four model matrix locations) */
+enum eBatchDataIdx { Part = 6 };
+
+struct BatchVertex
+{
+    Vector3D pos;
+    Vector4D color;
+    GLuint part;
+};
+
+/* geometry of one rigid part in its own object space */
+struct StaticBatchPart
+{
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+};
+
+/* several rigid parts merged into one vertex and index buffer, each vertex is transformed by the palette entry of its
+ * part, so the whole model is a single draw */
+struct StaticBatch
+{
+    VertexArrayHandle vao;
+    BufferHandle vbo;
+    BufferHandle ebo;
+
+    unsigned int size_vbo = 0;
+    unsigned int size_ibo = 0;
+
+    /* model matrix of each part, set by the scene and uploaded by staticBatchDraw(...) */
+    std::vector<Matrix4D> palette;
+};
+
+/**
+ * @brief Merges rigid parts into one batch. Part i is moved by palette[i].
+ *
+ * @param parts Geometry of the parts (at most STATIC_BATCH_MAX_PARTS).
+ *
+ * @return Initialized batch with identity matrices in its palette.
+ *
+ * usage:
+ *
+ *   StaticBatch car = staticBatchCreate({body, wheel, wheel});
+ *   car.palette[1] = wheelMatrix;
+ *   glUseProgram(palette-shader);
+ *   staticBatchDraw(car, stream);
+ */
+StaticBatch staticBatchCreate(const std::vector<StaticBatchPart>& parts);
+
+/**
+ * @brief Creates the batch part of a single colored mesh.
+ *
+ * @param positions Position data for each vertex of the part.
+ * @param indices List of indices that form triangles.
+ * @param color Color used for each of the vertices.
+ *
+ * @return Part for staticBatchCreate(...).
+ */
+StaticBatchPart staticBatchPart(const std::vector<Vector3D>& positions, const std::vector<unsigned int>& indices, const Vector4D& color);
+
+/**
+ * @brief Releases the buffers of a batch.
+ *
+ * @param batch Batch to delete.
+ */
+void staticBatchDelete(StaticBatch& batch);
+
+/**
+ * @brief Uploads the palette into the Palette uniform block with one stream buffer write and draws all parts with a
+ * single glDrawElements. The shader program (PALETTE variant) has to be bound by the caller.
+ *
+ * @param batch Batch to draw.
+ * @param stream Stream buffer receiving the palette.
+ */
+void staticBatchDraw(const StaticBatch& batch, StreamBuffer& stream);
+
+/**
+ * @brief Draws the batch with a palette owned by the caller, e.g. to draw several poses of one batch per frame
+ * without copying into batch.palette.
+ *
+ * @param batch Batch to draw.
+ * @param palette Matrix of each part.
+ * @param count Number of matrices (at most STATIC_BATCH_MAX_PARTS).
+ * @param stream Stream buffer receiving the palette.
+ */
+void staticBatchDraw(const StaticBatch& batch, const Matrix4D* palette, unsigned int count, StreamBuffer& stream);
@@ -0,0 +1,161 @@
+#include "streambuffer.h"
+#include "glstate.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace detail
+{
+    /* whether the (possibly wrapped) region intersects the linear range [begin, end) */
+    bool regionOverlaps(const StreamBufferRegion& region, GLsizeiptr begin, GLsizeiptr end)
+    {
+        if(region.begin <= region.end)
+        {
+            return begin < region.end && region.begin < end;
+        }
+        return begin < region.end || region.begin < end;
+    }
+
+    void waitForRegion(StreamBuffer& stream, const StreamBufferRegion& region)
+    {
+        GLenum result = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if(result == GL_TIMEOUT_EXPIRED)
+        {
+            auto start = std::chrono::steady_clock::now();
+            do
+            {
+                result = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while(result == GL_TIMEOUT_EXPIRED);
+
+            stream.stalls++;
+            stream.stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        glDeleteSync(region.fence);
+    }
+}
+
+StreamBuffer streamBufferCreate(GLsizeiptr size)
+{
+    StreamBuffer stream;
+    stream.size = size;
+
+    stream.id = bufferCreate();
+
+    if(GLAD_GL_ARB_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glStateBindBuffer(GL_COPY_WRITE_BUFFER, stream.id);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        stream.persistent = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+        stream.id.setSize(size);
+        glCheckError();
+    }
+    else
+    {
+        bufferData(stream.id, GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+
+    return stream;
+}
+
+void streamBufferDelete(StreamBuffer& stream)
+{
+    for(const StreamBufferRegion& region : stream.regions)
+    {
+        glDeleteSync(region.fence);
+    }
+
+    if(stream.persistent)
+    {
+        glStateBindBuffer(GL_COPY_WRITE_BUFFER, stream.id);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    stream = StreamBuffer();
+}
+
+StreamAllocation streamBufferMap(StreamBuffer& stream, GLsizeiptr size, GLsizeiptr alignment)
+{
+    GLsizeiptr offset = (stream.head + alignment - 1) / alignment * alignment;
+    if(offset + size > stream.size)
+    {
+        offset = 0;
+    }
+
+    GLsizeiptr used = stream.frameUsed + (offset >= stream.head ? offset - stream.head : stream.size - stream.head + offset) + size;
+    if(used >= stream.size)
+    {
+        std::cerr << "[StreamBuffer] Frame data exceeds ring size of " << stream.size << " bytes" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[StreamBuffer] Frame data exceeds ring size of " + std::to_string(stream.size) + " bytes");
+    }
+
+    /* wait until the GPU is done with every frame that overlaps the range. Frames finish in order, so all regions up
+     * to the newest overlapping one are retired; the oldest alone isn't enough, e.g. after wrapping it may lie in the
+     * skipped tail while the next one covers the start of the ring */
+    size_t retire = 0;
+    for(size_t i = 0; i < stream.regions.size(); i++)
+    {
+        if(detail::regionOverlaps(stream.regions[i], offset, offset + size))
+        {
+            retire = i + 1;
+        }
+    }
+    for(; retire > 0; retire--)
+    {
+        detail::waitForRegion(stream, stream.regions.front());
+        stream.regions.pop_front();
+    }
+
+    stream.frameUsed = used;
+    stream.head = offset + size;
+
+    StreamAllocation allocation;
+    allocation.offset = offset;
+
+    if(stream.persistent)
+    {
+        allocation.data = stream.persistent + offset;
+    }
+    else
+    {
+        /* ranges are fenced above, so the driver does not have to synchronize */
+        glStateBindBuffer(GL_COPY_WRITE_BUFFER, stream.id);
+        allocation.data = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size,
+                                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        stream.mapped = true;
+    }
+
+    return allocation;
+}
+
+void streamBufferUnmap(StreamBuffer& stream)
+{
+    if(!stream.mapped)
+    {
+        return;
+    }
+
+    glStateBindBuffer(GL_COPY_WRITE_BUFFER, stream.id);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    stream.mapped = false;
+}
+
+void streamBufferFrameEnd(StreamBuffer& stream)
+{
+    stream.lastFrameBytes = stream.frameUsed;
+    if(stream.frameUsed == 0)
+    {
+        return;
+    }
+
+    StreamBufferRegion region;
+    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region.begin = stream.frameBegin;
+    region.end = stream.head;
+    stream.regions.push_back(region);
+
+    stream.frameBegin = stream.head;
+    stream.frameUsed = 0;
+}
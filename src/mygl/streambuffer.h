@@ -0,0 +1,96 @@
+#pragma once
+
+#include "base.h"
+#include "resource.h"
+
+#include <deque>
+
+/* range of the ring written during one frame, guarded by a fence inserted after the frame's commands */
+struct StreamBufferRegion
+{
+    GLsync fence = nullptr;
+    GLsizeiptr begin = 0;
+    GLsizeiptr end = 0;
+};
+
+struct StreamBuffer
+{
+    BufferHandle id;
+    GLsizeiptr size = 0;
+
+    /* base pointer of the persistent mapping, nullptr if the unsynchronized map fallback is used */
+    unsigned char* persistent = nullptr;
+    bool mapped = false;
+
+    GLsizeiptr head = 0;
+    GLsizeiptr frameBegin = 0;
+    GLsizeiptr frameUsed = 0;
+    std::deque<StreamBufferRegion> regions;
+
+    /* statistics */
+    unsigned int stalls = 0;
+    double stallSeconds = 0.0;
+    GLsizeiptr lastFrameBytes = 0;
+};
+
+struct StreamAllocation
+{
+    void* data = nullptr;
+    GLsizeiptr offset = 0;
+};
+
+/**
+ * @brief Creates a ring buffer for data that is rewritten every frame (instance data, indirect commands, uniform
+ * blocks, ...). If GL_ARB_buffer_storage is available the buffer is mapped once with
+ * GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT, otherwise each allocation is mapped unsynchronized. Fences guard the
+ * ranges written in previous frames so that the CPU never overwrites data the GPU still reads.
+ *
+ * @param size Size of the ring in bytes, should hold the data of about three frames.
+ *
+ * @return Initialized stream buffer.
+ *
+ * usage:
+ *
+ *   StreamBuffer stream = streamBufferCreate(4 << 20);
+ *   StreamAllocation alloc = streamBufferMap(stream, sizeof(Matrix4D), 16);
+ *   memcpy(alloc.data, model.ptr(), sizeof(Matrix4D));
+ *   streamBufferUnmap(stream);
+ *   glBindBuffer(GL_ARRAY_BUFFER, stream.id);  // read data at alloc.offset
+ *   ...
+ *   streamBufferFrameEnd(stream);
+ */
+StreamBuffer streamBufferCreate(GLsizeiptr size);
+
+/**
+ * @brief Cleanup the mapping, the fences and the OpenGL buffer of a stream buffer.
+ *
+ * @param stream Stream buffer to delete.
+ */
+void streamBufferDelete(StreamBuffer& stream);
+
+/**
+ * @brief Reserves a range of the ring and returns a pointer to write it. Blocks only if the range is still in use by
+ * the GPU (counted as stall).
+ *
+ * @param stream Stream buffer.
+ * @param size Number of bytes to reserve.
+ * @param alignment Alignment of the returned offset in bytes.
+ *
+ * @return Write pointer and byte offset of the range inside the buffer object.
+ */
+StreamAllocation streamBufferMap(StreamBuffer& stream, GLsizeiptr size, GLsizeiptr alignment);
+
+/**
+ * @brief Finishes writing the last range returned by streamBufferMap. Has to be called before the data is used by
+ * OpenGL (no-op for persistently mapped buffers).
+ *
+ * @param stream Stream buffer.
+ */
+void streamBufferUnmap(StreamBuffer& stream);
+
+/**
+ * @brief Fences all ranges written since the last call. Has to be called once per frame after the draws using them.
+ *
+ * @param stream Stream buffer.
+ */
+void streamBufferFrameEnd(StreamBuffer& stream);
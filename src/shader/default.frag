@@ -1,22 +1,30 @@
 #version 330 core
 
-uniform bool checkerboard;
-
 in vec4 tColor;
 in vec3 tFragPos;
 out vec4 FragColor;
 
+#ifdef DITHER
+/* fraction of pixels handed over to the impostor while cross-fading (see impostor.frag) */
+uniform float uFade;
+#endif
+
 void main(void)
 {
-    if (!checkerboard)
+#ifdef DITHER
+    float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if(dither < uFade)
     {
-        FragColor = tColor;
-    } 
-    else
-    {
-        vec3 color1 = vec3(0.0f); 
-        vec3 color2 = vec3(0.5f); 
-        vec3 texColor = mix(color1, color2, 0.5 * mod(floor(tFragPos.x) + floor(tFragPos.y) + floor(tFragPos.z), 2));
-        FragColor = vec4(texColor + vec3(tColor) * 0.5, tColor.z);
+        discard;
     }
+#endif
+
+#ifdef CHECKERBOARD
+    vec3 color1 = vec3(0.0f); 
+    vec3 color2 = vec3(0.5f); 
+    vec3 texColor = mix(color1, color2, 0.5 * mod(floor(tFragPos.x) + floor(tFragPos.y) + floor(tFragPos.z), 2));
+    FragColor = vec4(texColor + vec3(tColor) * 0.5, tColor.z);
+#else
+    FragColor = tColor;
+#endif
 }
@@ -3,16 +3,40 @@
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec4 aColor;
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+#ifdef PALETTE
+/* static batch: every vertex is moved by the matrix of its part (see mygl/staticbatch.h) */
+layout(location = 6) in uint aPart;
+
+layout(std140) uniform Palette
+{
+    mat4 uPalette[16];
+};
+#else
+layout(location = 2) in mat4 aModel;
+#endif
+
+layout(std140) uniform PerFrame
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec4 uCameraPosition;
+    float uTime;
+};
 
 out vec4 tColor;
 out vec3 tFragPos;
 
 void main(void)
 {
-    gl_Position = uProj * uView * uModel * vec4(aPosition, 1.0);
+#ifdef PALETTE
+    mat4 model = uPalette[aPart];
+#else
+    mat4 model = aModel;
+#endif
+
+    vec4 worldPos = model * vec4(aPosition, 1.0);
+    gl_Position = uViewProj * worldPos;
     tColor = aColor;
-    tFragPos = vec3(uModel * vec4(aPosition, 1.0));
+    tFragPos = vec3(worldPos);
 }
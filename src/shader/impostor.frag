@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec2 tUV;
+flat in vec2 tCell;
+flat in vec2 tWeight;
+flat in float tFade;
+out vec4 FragColor;
+
+uniform sampler2D uAtlas;
+uniform float uFrames;
+
+/* the atlas is cleared to transparent black, so its texels are premultiplied and can be blended as they are */
+vec4 atlasFrame(vec2 cell)
+{
+    return texture(uAtlas, (cell + tUV) / uFrames);
+}
+
+void main(void)
+{
+    /* same pattern as the dithered mesh in default.frag, each pixel shows either the mesh or the impostor */
+    float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if(dither >= tFade)
+    {
+        discard;
+    }
+
+    vec4 color = mix(mix(atlasFrame(tCell), atlasFrame(tCell + vec2(1.0, 0.0)), tWeight.x),
+                     mix(atlasFrame(tCell + vec2(0.0, 1.0)), atlasFrame(tCell + vec2(1.0, 1.0)), tWeight.x), tWeight.y);
+    if(color.a < 0.5)
+    {
+        discard;
+    }
+    FragColor = vec4(color.rgb / color.a, 1.0);
+}
@@ -0,0 +1,48 @@
+#version 330 core
+
+/* camera facing quad around the bounding sphere, textured with the atlas frames closest to the view direction
+   (see mygl/impostor.h) */
+layout(location = 0) in vec2 aCorner;
+layout(location = 2) in mat4 aModel;
+layout(location = 7) in float aFade;
+
+layout(std140) uniform PerFrame
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec4 uCameraPosition;
+    float uTime;
+};
+
+uniform vec4 uBounds;   // bounding sphere in model space
+uniform float uFrames;  // views per axis
+
+out vec2 tUV;
+flat out vec2 tCell;    // lower left of the 2x2 frames blended
+flat out vec2 tWeight;  // bilinear weights between them
+flat out float tFade;
+
+/* maps a direction of the upper hemisphere to [-1, 1]^2, inverse of the capture in impostor.cpp */
+vec2 hemiOctahedronEncode(vec3 d)
+{
+    d.y = max(d.y, 0.0);
+    vec2 p = d.xz / (abs(d.x) + abs(d.y) + abs(d.z));
+    return vec2(p.x + p.y, p.x - p.y);
+}
+
+void main(void)
+{
+    vec4 center = aModel * vec4(uBounds.xyz, 1.0);
+    float scale = max(length(aModel[0].xyz), max(length(aModel[1].xyz), length(aModel[2].xyz)));
+
+    vec3 direction = normalize(inverse(mat3(aModel)) * (uCameraPosition.xyz - center.xyz));
+    vec2 grid = (hemiOctahedronEncode(direction) * 0.5 + 0.5) * (uFrames - 1.0);
+    tCell = min(floor(grid), vec2(uFrames - 2.0));
+    tWeight = grid - tCell;
+
+    vec4 viewCenter = uView * center;
+    gl_Position = uProj * (viewCenter + vec4(aCorner * uBounds.w * scale, 0.0, 0.0));
+    tUV = aCorner * 0.5 + 0.5;
+    tFade = aFade;
+}
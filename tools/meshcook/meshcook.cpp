@@ -0,0 +1,231 @@
+/**
+ * meshcook - converts Wavefront OBJ files into the binary mesh format loaded by meshFileOpen(...).
+ *
+ * usage: meshcook input.obj output.mesh [--color r g b] [--no-optimize]
+ *
+ * Supported OBJ subset: "v x y z [r g b]" and "f" records with any number of corners (fan triangulated), negative
+ * indices and v/vt/vn corner syntax (only the position index is used). All other records are skipped.
+ */
+#include "mygl/meshfile.h"
+#include "mygl/meshopt.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace detail
+{
+    const char* skipSpaces(const char* it, const char* end)
+    {
+        while(it < end && (*it == ' ' || *it == '\t'))
+        {
+            it++;
+        }
+        return it;
+    }
+
+    const char* skipLine(const char* it, const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(it, '\n', end - it));
+        return newline ? newline + 1 : end;
+    }
+
+    /* parses up to count floats of the current line, returns how many were found */
+    unsigned int parseFloats(const char*& it, const char* end, float* values, unsigned int count)
+    {
+        unsigned int parsed = 0;
+        while(parsed < count)
+        {
+            it = skipSpaces(it, end);
+            if(it >= end || *it == '\n' || *it == '\r' || *it == '#')
+            {
+                break;
+            }
+
+            char* next = nullptr;
+            values[parsed] = std::strtof(it, &next);
+            if(next == it)
+            {
+                break;
+            }
+            it = next;
+            parsed++;
+        }
+        return parsed;
+    }
+
+    bool parseObj(const std::string& source, const Vector4D& defaultColor, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        const char* begin = source.data();
+        const char* end = begin + source.size();
+
+        /* count records first so that the output arrays are allocated exactly once */
+        size_t vertexRecords = 0;
+        size_t faceRecords = 0;
+        for(const char* it = begin; it < end; it = skipLine(it, end))
+        {
+            if(end - it > 1 && it[0] == 'v' && (it[1] == ' ' || it[1] == '\t'))
+            {
+                vertexRecords++;
+            }
+            else if(end - it > 1 && it[0] == 'f' && (it[1] == ' ' || it[1] == '\t'))
+            {
+                faceRecords++;
+            }
+        }
+        vertices.reserve(vertexRecords);
+        indices.reserve(faceRecords * 3);
+
+        unsigned int lineNumber = 0;
+        for(const char* it = begin; it < end; it = skipLine(it, end))
+        {
+            lineNumber++;
+            if(end - it < 2 || (it[1] != ' ' && it[1] != '\t'))
+            {
+                continue;
+            }
+
+            if(it[0] == 'v')
+            {
+                const char* cursor = it + 1;
+                float values[6];
+                unsigned int count = parseFloats(cursor, end, values, 6);
+                if(count < 3)
+                {
+                    std::cerr << "[meshcook] Invalid vertex in line " << lineNumber << std::endl;
+                    return false;
+                }
+
+                Vector4D color = count >= 6 ? Vector4D(values[3], values[4], values[5], 1.0f) : defaultColor;
+                vertices.push_back({{values[0], values[1], values[2]}, color});
+            }
+            else if(it[0] == 'f')
+            {
+                const char* cursor = it + 1;
+                unsigned int corners = 0;
+                unsigned int first = 0;
+                unsigned int previous = 0;
+
+                while(true)
+                {
+                    cursor = skipSpaces(cursor, end);
+                    if(cursor >= end || *cursor == '\n' || *cursor == '\r' || *cursor == '#')
+                    {
+                        break;
+                    }
+
+                    char* next = nullptr;
+                    long index = std::strtol(cursor, &next, 10);
+                    if(next == cursor || index == 0)
+                    {
+                        std::cerr << "[meshcook] Invalid face in line " << lineNumber << std::endl;
+                        return false;
+                    }
+
+                    /* skip texture coordinate and normal indices */
+                    cursor = next;
+                    while(cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\n' && *cursor != '\r')
+                    {
+                        cursor++;
+                    }
+
+                    long resolved = index > 0 ? index - 1 : static_cast<long>(vertices.size()) + index;
+                    if(resolved < 0 || resolved >= static_cast<long>(vertices.size()))
+                    {
+                        std::cerr << "[meshcook] Face index out of range in line " << lineNumber << std::endl;
+                        return false;
+                    }
+
+                    unsigned int vertex = static_cast<unsigned int>(resolved);
+                    if(corners == 0)
+                    {
+                        first = vertex;
+                    }
+                    else if(corners >= 2)
+                    {
+                        indices.push_back(first);
+                        indices.push_back(previous);
+                        indices.push_back(vertex);
+                    }
+                    previous = vertex;
+                    corners++;
+                }
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        std::cerr << "usage: meshcook input.obj output.mesh [--color r g b] [--no-optimize]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    Vector4D color = {0.7f, 0.7f, 0.7f, 1.0f};
+    bool optimize = true;
+    for(int i = 3; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], "--color") == 0 && i + 3 < argc)
+        {
+            color = {std::strtof(argv[i + 1], nullptr), std::strtof(argv[i + 2], nullptr), std::strtof(argv[i + 3], nullptr), 1.0f};
+            i += 3;
+        }
+        else if(std::strcmp(argv[i], "--no-optimize") == 0)
+        {
+            optimize = false;
+        }
+        else
+        {
+            std::cerr << "[meshcook] Unknown option " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::ifstream input(argv[1], std::ios::binary | std::ios::ate);
+    if(!input.is_open())
+    {
+        std::cerr << "[meshcook] Couldn't open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string source(static_cast<size_t>(input.tellg()), '\0');
+    input.seekg(0);
+    input.read(&source[0], source.size());
+
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    if(!detail::parseObj(source, color, vertices, indices))
+    {
+        return EXIT_FAILURE;
+    }
+
+    auto parsed = std::chrono::steady_clock::now();
+
+    if(optimize)
+    {
+        meshOptimize(vertices, indices, argv[1]);
+    }
+
+    try
+    {
+        meshFileWrite(argv[2], vertices, indices);
+    }
+    catch(const std::exception&)
+    {
+        return EXIT_FAILURE;
+    }
+
+    auto done = std::chrono::steady_clock::now();
+    std::cout << "[meshcook] " << argv[2] << ": " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles (parse "
+              << std::chrono::duration<double, std::milli>(parsed - start).count() << " ms, total "
+              << std::chrono::duration<double, std::milli>(done - start).count() << " ms)" << std::endl;
+
+    return EXIT_SUCCESS;
+}